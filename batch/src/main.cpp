@@ -0,0 +1,744 @@
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <tuple>
+#include "ofMain.h"
+#include "Cannon/CannonSimulation.h"
+#include "Cannon/ReplayLog.h"
+#include "Cannon/DispersionStudy.h"
+#include "Cannon/FiringTable.h"
+#include "YAMPE/IntegrationKernel.h"
+#include "YAMPE/SpatialHash.h"
+#include "YAMPE/TrajectoryFile.h"
+
+/**
+ * A single shot as read from the parameter file.
+ */
+struct Shot {
+    float muzzleSpeed;
+    float elevation;
+    float direction;
+};
+
+static void usage() {
+    cerr <<"usage: batch <parameters> <results> [-n shots] [-dt step] [-tmax seconds]" <<endl
+         <<"             [-integrator euler|verlet|rk4|rk45] [-tolerance error]" <<endl
+         <<"             [-trajectories file] [-pack 0|1]" <<endl
+         <<"  parameters  one shot per line: muzzleSpeed elevation direction" <<endl
+         <<"  results     CSV file of impact point, flight time and energy error" <<endl
+         <<"  -n          number of shots to run, cycling through the parameters" <<endl
+         <<"              (default: one per parameter line)" <<endl
+         <<"  -dt         fixed simulation step in seconds (default 0.01)" <<endl
+         <<"  -tmax       give up on a shot after this flight time (default 60)" <<endl
+         <<"  -integrator integration scheme (default euler)" <<endl
+         <<"  -tolerance  local error tolerance of rk45 (default 1e-4)" <<endl
+         <<"  -trajectories  stream every step of every shot to a trajectory file" <<endl
+         <<"  -pack       pack the columns of the trajectory file (default 1)" <<endl
+         <<"A summary of CPU time and impact error against the exact (drag free)" <<endl
+         <<"landing point is written to standard output, to compare integrators." <<endl
+         <<endl
+         <<"usage: batch -scaling <results> [-threads max] [-steps n] [-dt step]" <<endl
+         <<"             [-integrator euler|verlet|rk4]" <<endl
+         <<"  results     CSV file of time per step for volleys of 10k to 1M balls" <<endl
+         <<"              on 1, 2, 4 ... max threads (default: one per core)" <<endl
+         <<"  -steps      steps timed per run (default 20)" <<endl
+         <<endl
+         <<"usage: batch -replay <log> [-seek seconds]" <<endl
+         <<"  log         replay log recorded by the app (data/last.replay)" <<endl
+         <<"  -seek       jump to this time since recording started, from the" <<endl
+         <<"              nearest snapshot (default: play the whole log and check" <<endl
+         <<"              every snapshot against the replay)" <<endl
+         <<endl
+         <<"usage: batch -dispersion <heatmap> [-shots n] [-threads n] [-x metres] [-z metres]" <<endl
+         <<"             [-speed m/s] [-speedSigma m/s] [-elevationSigma degrees]" <<endl
+         <<"             [-directionSigma degrees] [-drag k2] [-windSigma m/s]" <<endl
+         <<"  heatmap     CSV file of impacts per cell around the target" <<endl
+         <<"  -shots      shots in the study (default 1000000)" <<endl
+         <<"  -threads    threads to run them on (default: one per core)" <<endl
+         <<"  -x -z       target position, aimed at with the flat trajectory (default 5 3)" <<endl
+         <<"  -drag       quadratic drag coefficient (default 0: no drag, so no wind)" <<endl
+         <<endl
+         <<"usage: batch -trajectory <file>" <<endl
+         <<"  file        trajectory file from -trajectories or the app (data/trajectories.ytr)," <<endl
+         <<"              summarised column by column from a memory mapping" <<endl
+         <<endl
+         <<"usage: batch -selftest <check>" <<endl
+         <<"  check       all, or one of" <<endl
+         <<"              kernels: the integration kernels this CPU supports against" <<endl
+         <<"              Particle::integrate" <<endl
+         <<"              firing: random firing table lookups against the exact solver" <<endl
+         <<"              and the table's error bound" <<endl
+         <<"              contacts: spatial hash contacts, serial and parallel, against" <<endl
+         <<"              testing every pair" <<endl
+         <<"Exits with status 2 if a check fails." <<endl;
+}
+
+/**
+ * Hand each option after the two positional arguments, with its value, to
+ * apply. Prints the usage and returns false if an option has no value or
+ * apply does not know it.
+ */
+static bool parseOptions(int argc, char* argv[], const std::function<bool(const string&, const char*)>& apply) {
+    for (int i = 3; i < argc; i += 2) {
+        string option = argv[i];
+        if (i+1 == argc) {
+            cerr <<"option " <<option <<" expects a value" <<endl;
+            usage();
+            return false;
+        }
+        if (!apply(option, argv[i+1])) {
+            usage();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parse an integrator name, returning -1 if unknown.
+ */
+static int integratorType(const string& name) {
+    if (name == "euler") return YAMPE::Integrator::EULER;
+    if (name == "verlet") return YAMPE::Integrator::VERLET;
+    if (name == "rk4") return YAMPE::Integrator::RK4;
+    if (name == "rk45") return YAMPE::Integrator::RK45;
+    return -1;
+}
+
+/**
+ * Where a shot lands without drag, from the closed form range.
+ */
+static ofVec3f exactImpact(const CannonSimulation& sim) {
+    float distance = sim.range(sim.elevation);
+    float rightDirection = ofDegToRad(sim.direction + 90.0f);
+    return ofVec3f(sin(rightDirection) * distance, 0, cos(rightDirection) * distance);
+}
+
+/**
+ * Read the shots from the parameter file, ignoring blank and comment lines.
+ */
+static bool readShots(const string& fileName, vector<Shot>& shots) {
+    ifstream in(fileName.c_str());
+    if (!in) return false;
+    string line;
+    while (getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos || line[start] == '#') continue;
+        istringstream fields(line);
+        Shot shot;
+        if (fields >>shot.muzzleSpeed >>shot.elevation >>shot.direction) {
+            shots.push_back(shot);
+        } else {
+            cerr <<"ignoring malformed line: " <<line <<endl;
+        }
+    }
+    return true;
+}
+
+/**
+ * Time CannonSimulation::update with a whole volley in flight, on 1 to
+ * maxThreads threads, and check that every thread count leaves the balls
+ * in exactly the same state as one thread.
+ */
+static int scaling(int argc, char* argv[]) {
+    
+    string resultsFile = argv[2];
+    int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    int steps = 20;
+    float dt = 0.01f;
+    int integrator = YAMPE::Integrator::EULER;
+    bool isParsed = parseOptions(argc, argv, [&](const string& option, const char* value) {
+        if (option == "-threads") maxThreads = atoi(value);
+        else if (option == "-steps") steps = atoi(value);
+        else if (option == "-dt") dt = atof(value);
+        else if (option == "-integrator") integrator = integratorType(value);
+        else return false;
+        return true;
+    });
+    if (!isParsed) return 1;
+    if (maxThreads < 1 || steps < 1 || dt <= 0.0f || integrator < 0) {
+        usage();
+        return 1;
+    }
+    
+    ofstream out(resultsFile.c_str());
+    if (!out) {
+        cerr <<"cannot write results file " <<resultsFile <<endl;
+        return 1;
+    }
+    out <<"balls,threads,integrator,secondsPerStep,speedup,identical" <<endl;
+    
+    const size_t volleys[] = {10000, 100000, 1000000};
+    bool allIdentical = true;
+    for (size_t v = 0; v < sizeof(volleys)/sizeof(volleys[0]); v++) {
+        size_t balls = volleys[v];
+        YAMPE::ParticleStore reference;
+        double serialSeconds = 0.0;
+        
+        for (int threads = 1; threads <= maxThreads; threads = threads < maxThreads ? min(2*threads, maxThreads) : threads+1) {
+            YAMPE::TaskScheduler scheduler(threads);
+            CannonSimulation sim(balls);
+            sim.setIntegrator(integrator);
+            sim.scheduler = &scheduler;
+            sim.drag->enabled = true;
+            
+            // the same volley every run, spread out so that none land while timed
+            ofSeedRandom(int(balls));
+            for (size_t i = 0; i < balls; i++) {
+                sim.muzzleSpeed = ofRandom(2.0f, 6.0f);
+                sim.elevation = ofRandom(10.0f, 80.0f);
+                sim.direction = ofRandom(0.0f, 360.0f);
+                sim.fire();
+                sim.projectiles.particles[sim.lastShot].setPosition(
+                    ofVec3f(ofRandom(-100.0f, 100.0f), ofRandom(20.0f, 60.0f), ofRandom(-100.0f, 100.0f)));
+            }
+            // the first update links every ball into the spatial hash
+            sim.update(dt);
+            
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int i = 0; i < steps; i++) sim.update(dt);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / steps;
+            
+            const YAMPE::ParticleStore& particles = sim.projectiles.particles;
+            bool identical = true;
+            if (threads == 1) {
+                reference = particles;
+                serialSeconds = seconds;
+            } else {
+                identical = particles.px == reference.px && particles.py == reference.py && particles.pz == reference.pz
+                         && particles.vx == reference.vx && particles.vy == reference.vy && particles.vz == reference.vz;
+                allIdentical = allIdentical && identical;
+            }
+            out <<balls <<',' <<threads <<',' <<sim.integrator->label() <<',' <<seconds <<','
+                <<serialSeconds / seconds <<',' <<(identical ? "yes" : "no") <<endl;
+            cout <<balls <<" balls, " <<threads <<" thread(s): " <<1000.0 * seconds <<" ms/step, speedup "
+                 <<serialSeconds / seconds <<(identical ? "" : " (DIFFERS from one thread)") <<endl;
+        }
+    }
+    return allIdentical ? 0 : 2;
+}
+
+/**
+ * Play a replay log back as fast as possible, either all of it (checking
+ * that it reproduces every snapshot) or up to a seek time.
+ */
+static int replay(int argc, char* argv[]) {
+    
+    string logFile = argv[2];
+    double seekTime = -1.0;
+    bool isParsed = parseOptions(argc, argv, [&](const string& option, const char* value) {
+        if (option != "-seek") return false;
+        seekTime = atof(value);
+        return true;
+    });
+    if (!isParsed) return 1;
+    
+    ReplayPlayer player;
+    if (!player.open(logFile)) {
+        cerr <<"cannot read replay log " <<logFile <<endl;
+        return 1;
+    }
+    double duration = player.timeAt(player.lastStep());
+    cout <<logFile <<": seed " <<player.header().seed <<", " <<player.fireCount() <<" shots, "
+         <<player.snapshotCount() <<" snapshots, " <<duration <<" s"
+         <<(player.isComplete() ? "" : " (cut short)") <<endl;
+    
+    CannonSimulation sim(player.header().capacity);
+    uint64_t step = seekTime >= 0.0 ? player.stepAt(seekTime) : player.lastStep();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (seekTime >= 0.0) {
+        player.seek(sim, step);
+    } else {
+        player.seek(sim, player.firstStep());
+        player.play(sim, step);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double played = player.timeAt(step);
+    
+    cout <<"at " <<played <<" s (step " <<step <<") in " <<seconds <<" s";
+    if (seekTime < 0.0 && seconds > 0.0) cout <<" (" <<played / seconds <<"x real time)";
+    cout <<": t = " <<sim.t <<", " <<sim.projectiles.activeCount() <<" balls in flight, "
+         <<sim.targetHits <<" / " <<sim.shotsFired <<" target hits" <<endl;
+    
+    if (player.divergedSnapshots > 0) {
+        cerr <<player.divergedSnapshots <<" of " <<player.verifiedSnapshots + player.divergedSnapshots
+             <<" snapshots differ from the replay, the first at step " <<player.firstDivergence <<endl;
+        return 2;
+    }
+    if (seekTime < 0.0) cout <<player.verifiedSnapshots <<" snapshots reproduced exactly" <<endl;
+    return 0;
+}
+
+/**
+ * Summarise a trajectory file, reading it a column at a time.
+ */
+static int trajectory(int argc, char* argv[]) {
+    
+    string fileName = argv[2];
+    if (argc > 3) {
+        usage();
+        return 1;
+    }
+    YAMPE::TrajectoryReader reader;
+    if (!reader.open(fileName)) {
+        cerr <<"cannot read trajectory file " <<fileName <<endl;
+        return 1;
+    }
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    float minTime = INFINITY, maxTime = -INFINITY;
+    float maxHeight = -INFINITY, maxSpeed = 0.0f;
+    double sumEnergy = 0.0;
+    int32_t maxId = -1;
+    size_t packed = 0;
+    for (size_t chunk = 0; chunk < reader.chunkCount(); chunk++) {
+        size_t rows = reader.chunkRows(chunk);
+        for (int c = 0; c < YAMPE::TrajectoryFile::COLUMN_COUNT; c++) {
+            if (reader.encoding(chunk, YAMPE::TrajectoryFile::Column(c)) == YAMPE::TrajectoryFile::PACKED) packed++;
+        }
+        // a packed column stays valid only until the next is read
+        const float* time = reader.column(chunk, YAMPE::TrajectoryFile::TIME);
+        for (size_t i = 0; i < rows; i++) {
+            minTime = min(minTime, time[i]);
+            maxTime = max(maxTime, time[i]);
+        }
+        const int32_t* ids = reader.ids(chunk);
+        for (size_t i = 0; i < rows; i++) maxId = max(maxId, ids[i]);
+        const float* y = reader.column(chunk, YAMPE::TrajectoryFile::PY);
+        for (size_t i = 0; i < rows; i++) maxHeight = max(maxHeight, y[i]);
+        const float* kinetic = reader.column(chunk, YAMPE::TrajectoryFile::KINETIC_ENERGY);
+        for (size_t i = 0; i < rows; i++) sumEnergy += kinetic[i];
+        const float* potential = reader.column(chunk, YAMPE::TrajectoryFile::POTENTIAL_ENERGY);
+        for (size_t i = 0; i < rows; i++) sumEnergy += potential[i];
+        for (int c = YAMPE::TrajectoryFile::VX; c <= YAMPE::TrajectoryFile::VZ; c++) {
+            const float* v = reader.column(chunk, YAMPE::TrajectoryFile::Column(c));
+            for (size_t i = 0; i < rows; i++) maxSpeed = max(maxSpeed, fabsf(v[i]));
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    cout <<fileName <<": " <<reader.rows() <<" rows in " <<reader.chunkCount() <<" chunks, "
+         <<reader.fileSize() / 1048576.0 <<" MB (" <<reader.rawSize() / 1048576.0 <<" MB unpacked, "
+         <<packed <<" packed columns)" <<endl;
+    if (reader.rows() == 0) return 0;
+    cout <<"time " <<minTime <<" to " <<maxTime <<" s, balls 0 to " <<maxId <<", max height " <<maxHeight
+         <<" m, max velocity component " <<maxSpeed <<" m/s, mean energy " <<sumEnergy / reader.rows() <<" J" <<endl;
+    cout <<"read in " <<seconds <<" s (" <<(seconds > 0 ? reader.rows() / seconds / 1e6 : 0) <<"M rows/s)" <<endl;
+    return 0;
+}
+
+/**
+ * Check that every integration kernel this CPU supports moves particles
+ * exactly as Particle::integrate does: immovable particles, runs of mixed
+ * damping, and batch sizes and range starts that leave a scalar remainder.
+ */
+static bool checkKernels() {
+    const size_t sizes[] = {1, 3, 4, 5, 7, 8, 9, 13, 16, 17, 31, 100, 1023};
+    const float dampings[] = {1.0f, 0.999f, 0.99f, 0.5f};
+    const float dt = 0.01f;
+    bool passed = true;
+    ofSeedRandom(2);
+    for (size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        vector<YAMPE::Particle> particles(n);
+        vector<ofVec3f> forces(n);
+        for (size_t i = 0; i < n; i++) {
+            YAMPE::Particle& p = particles[i];
+            p.setPosition(ofVec3f(ofRandom(-10, 10), ofRandom(0, 10), ofRandom(-10, 10)));
+            p.setVelocity(ofVec3f(ofRandom(-5, 5), ofRandom(-5, 5), ofRandom(-5, 5)));
+            p.acceleration = ofVec3f(0, ofRandom(-10, 0), 0);
+            p.setInverseMass(ofRandom(1.0f) < 0.2f ? 0.0f : ofRandom(0.1f, 2.0f));
+            // runs of equal damping, as in a pool, broken at random
+            p.setDamping(i > 0 && ofRandom(1.0f) < 0.5f ? particles[i-1].damping() : dampings[int(ofRandom(4)) % 4]);
+            forces[i] = ofVec3f(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1));
+        }
+        // from the start, and from an odd offset so no lane starts aligned
+        size_t begins[] = {0, n/3 | 1};
+        for (int b = 0; b < 2; b++) {
+            size_t begin = min(begins[b], n);
+            vector<YAMPE::Particle> expected = particles;
+            for (size_t i = begin; i < n; i++) {
+                expected[i].applyForce(forces[i]);
+                expected[i].integrate(dt);
+            }
+            for (int type = YAMPE::IntegrationKernel::SCALAR; type <= YAMPE::IntegrationKernel::AVX2; type++) {
+                YAMPE::IntegrationKernel::Type kernel = YAMPE::IntegrationKernel::Type(type);
+                if (!YAMPE::IntegrationKernel::isSupported(kernel)) continue;
+                YAMPE::ParticleStore store;
+                for (size_t i = 0; i < n; i++) store.add(particles[i]).applyForce(forces[i]);
+                YAMPE::IntegrationKernel::integrate(kernel, store, dt, begin, n);
+                
+                size_t mismatches = 0;
+                for (size_t i = 0; i < n; i++) {
+                    const YAMPE::Particle& e = expected[i];
+                    // immovable particles and those outside the range keep their force
+                    bool isMoved = i >= begin && e.inverseMass() > 0.0f;
+                    ofVec3f force = isMoved ? ofVec3f::zero() : forces[i];
+                    if (store[i].position() != e.position || store[i].velocity() != e.velocity
+                        || store.fx[i] != force.x || store.fy[i] != force.y || store.fz[i] != force.z) mismatches++;
+                }
+                if (mismatches > 0) {
+                    cerr <<"kernels: " <<YAMPE::IntegrationKernel::name(kernel) <<" differs from Particle::integrate for "
+                         <<mismatches <<" of " <<n <<" particles (range " <<begin <<" to " <<n <<")" <<endl;
+                    passed = false;
+                }
+            }
+        }
+    }
+    cout <<"kernels: ";
+    for (int type = YAMPE::IntegrationKernel::SCALAR; type <= YAMPE::IntegrationKernel::AVX2; type++) {
+        YAMPE::IntegrationKernel::Type kernel = YAMPE::IntegrationKernel::Type(type);
+        if (YAMPE::IntegrationKernel::isSupported(kernel)) cout <<YAMPE::IntegrationKernel::name(kernel) <<' ';
+    }
+    cout <<(passed ? "agree" : "FAIL") <<endl;
+    return passed;
+}
+
+/**
+ * Check that no lookup in the app's firing table is further from the exact
+ * solver than the error bound build() stores with it, for random speeds and
+ * distances, half of them within a tenth of maximum range of the cannon
+ * where the flat elevation changes fastest.
+ */
+static bool checkFiringTable() {
+    FiringTable table;
+    table.build(3.0f, 5.0f, 16, 1024, CannonSimulation::GRAVITY, CannonSimulation::MUZZLE_HEIGHT);
+    const long queries = 1000000;
+    float worst = 0.0f;
+    long outside = 0;
+    ofSeedRandom(9);
+    for (long k = 0; k < queries; k++) {
+        float speed = ofRandom(3.0f, 5.0f);
+        FiringSolver solver(speed, CannonSimulation::GRAVITY, CannonSimulation::MUZZLE_HEIGHT);
+        float distance = solver.maximumRange() * (k % 2 == 0 ? ofRandom(1.0f) : ofRandom(0.1f));
+        FiringSolution exact = solver.solve(distance);
+        FiringSolution approximate = table.lookup(speed, distance);
+        float error = max(fabsf(exact.low - approximate.low), fabsf(exact.high - approximate.high));
+        worst = max(worst, error);
+        if (error > table.maxError() || approximate.inRange != exact.inRange) outside++;
+    }
+    bool passed = outside == 0;
+    cout <<"firing table: worst error " <<worst <<" deg of " <<queries <<" lookups, bound " <<table.maxError()
+         <<" deg" <<(passed ? "" : " (EXCEEDED)") <<endl;
+    if (!passed) cerr <<"firing table: " <<outside <<" lookups outside the bound" <<endl;
+    return passed;
+}
+
+/**
+ * Every sphere-sphere and sphere-box overlap, found by testing every pair,
+ * as (first, second, box) keys with their penetration.
+ */
+static map<tuple<int, int, int>, float> bruteForceContacts(const YAMPE::ParticleStore& particles,
+                                                           const vector<ofVec3f>& boxes) {
+    map<tuple<int, int, int>, float> contacts;
+    for (size_t i = 0; i < particles.size(); i++) {
+        if (particles.inverseMass[i] <= 0.0f) continue;
+        ofVec3f p(particles.px[i], particles.py[i], particles.pz[i]);
+        float r = particles.radius[i];
+        for (size_t j = i+1; j < particles.size(); j++) {
+            if (particles.inverseMass[j] <= 0.0f) continue;
+            float distance = p.distance(ofVec3f(particles.px[j], particles.py[j], particles.pz[j]));
+            if (distance < r + particles.radius[j]) {
+                contacts[make_tuple(int(i), int(j), -1)] = r + particles.radius[j] - distance;
+            }
+        }
+        for (size_t b = 0; b+1 < boxes.size(); b += 2) {
+            const ofVec3f& boxMin = boxes[b];
+            const ofVec3f& boxMax = boxes[b+1];
+            ofVec3f closest(ofClamp(p.x, boxMin.x, boxMax.x), ofClamp(p.y, boxMin.y, boxMax.y),
+                            ofClamp(p.z, boxMin.z, boxMax.z));
+            float distance = p.distance(closest);
+            // the penetration of a centre inside the box depends on the nearest face, not checked here
+            if (distance < r) contacts[make_tuple(int(i), -1, int(b/2))] = distance > 0.0f ? r - distance : NAN;
+        }
+    }
+    return contacts;
+}
+
+/**
+ * Compare the contacts of a spatial hash with the brute force ones, for
+ * random spheres (some larger than a cell, some immovable) and boxes, as
+ * they are first linked and after they have moved, searched serially and
+ * over a scheduler (which must give the same contacts in the same order).
+ */
+static bool checkContacts() {
+    bool passed = true;
+    YAMPE::TaskScheduler scheduler(4);
+    ofSeedRandom(14);
+    long checked = 0;
+    for (int trial = 0; trial < 20; trial++) {
+        size_t n = size_t(ofRandom(1, 3000));
+        float extent = ofRandom(1.0f, 10.0f);
+        YAMPE::ParticleStore particles;
+        for (size_t i = 0; i < n; i++) {
+            particles.add()
+                .setPosition(ofVec3f(ofRandom(-extent, extent), ofRandom(-extent, extent), ofRandom(-extent, extent)))
+                .setRadius(ofRandom(1.0f) < 0.05f ? ofRandom(0.2f, 0.6f) : ofRandom(0.01f, 0.12f))
+                .setInverseMass(ofRandom(1.0f) < 0.1f ? 0.0f : 1.0f);
+        }
+        YAMPE::SpatialHash hash(0.25f, 64);
+        vector<ofVec3f> boxes;
+        int boxCount = int(ofRandom(0, 4));
+        for (int b = 0; b < boxCount; b++) {
+            ofVec3f centre(ofRandom(-extent, extent), ofRandom(-extent, extent), ofRandom(-extent, extent));
+            ofVec3f half(ofRandom(0.05f, 1.5f), ofRandom(0.05f, 1.5f), ofRandom(0.05f, 1.5f));
+            boxes.push_back(centre - half);
+            boxes.push_back(centre + half);
+            hash.addBox(centre - half, centre + half);
+        }
+        
+        for (int pass = 0; pass < 2; pass++) {
+            if (pass == 1) {
+                // move some particles a little and some far, so some change cell
+                for (size_t i = 0; i < n; i++) {
+                    float step = ofRandom(1.0f) < 0.5f ? 0.05f : extent;
+                    particles[i].setPosition(particles[i].position()
+                                             + ofVec3f(ofRandom(-step, step), ofRandom(-step, step), ofRandom(-step, step)));
+                }
+            }
+            hash.update(particles, 0, n);
+            vector<YAMPE::Contact> serial, parallel;
+            hash.findContacts(particles, serial);
+            hash.findContacts(particles, parallel, &scheduler, 64);
+            map<tuple<int, int, int>, float> expected = bruteForceContacts(particles, boxes);
+            
+            map<tuple<int, int, int>, float> found;
+            size_t wrongDepth = 0;
+            for (size_t c = 0; c < serial.size(); c++) {
+                const YAMPE::Contact& contact = serial[c];
+                tuple<int, int, int> key = make_tuple(contact.first, contact.second, contact.box);
+                found[key] = contact.penetration;
+                map<tuple<int, int, int>, float>::const_iterator e = expected.find(key);
+                if (e != expected.end() && !isnan(e->second) && fabsf(e->second - contact.penetration) > 1e-5f) wrongDepth++;
+            }
+            bool isSameSet = found.size() == serial.size() && found.size() == expected.size();
+            for (map<tuple<int, int, int>, float>::const_iterator e = expected.begin(); isSameSet && e != expected.end(); ++e) {
+                isSameSet = found.count(e->first) > 0;
+            }
+            bool isSameOrder = parallel.size() == serial.size();
+            for (size_t c = 0; isSameOrder && c < serial.size(); c++) {
+                isSameOrder = parallel[c].first == serial[c].first && parallel[c].second == serial[c].second
+                           && parallel[c].box == serial[c].box && parallel[c].penetration == serial[c].penetration;
+            }
+            if (!isSameSet || wrongDepth > 0 || !isSameOrder) {
+                cerr <<"contacts: " <<n <<" spheres, " <<boxCount <<" boxes, pass " <<pass <<": " <<serial.size()
+                     <<" contacts (" <<parallel.size() <<" in parallel), " <<expected.size() <<" by brute force, "
+                     <<wrongDepth <<" with the wrong penetration" <<(isSameOrder ? "" : ", parallel order differs") <<endl;
+                passed = false;
+            }
+            checked += expected.size();
+        }
+    }
+    cout <<"contacts: " <<checked <<" brute force contacts " <<(passed ? "found serially and in parallel" : "FAIL") <<endl;
+    return passed;
+}
+
+/**
+ * Run the named consistency checks, or all of them.
+ */
+static int selfTest(int argc, char* argv[]) {
+    
+    string check = argv[2];
+    bool isAll = check == "all";
+    if (argc > 3 || (!isAll && check != "kernels" && check != "firing" && check != "contacts")) {
+        usage();
+        return 1;
+    }
+    bool passed = true;
+    if (isAll || check == "kernels") passed = checkKernels() && passed;
+    if (isAll || check == "firing") passed = checkFiringTable() && passed;
+    if (isAll || check == "contacts") passed = checkContacts() && passed;
+    return passed ? 0 : 2;
+}
+
+/**
+ * Aim at a target and fire a Monte Carlo study of perturbed shots at it.
+ */
+static int dispersion(int argc, char* argv[]) {
+    
+    string heatmapFile = argv[2];
+    long shots = 1000000;
+    int threads = 0;
+    CannonSimulation sim;
+    sim.target.set(5.0f, 0.0f, 3.0f);
+    DispersionStudy study;
+    bool isParsed = parseOptions(argc, argv, [&](const string& option, const char* text) {
+        float value = atof(text);
+        if (option == "-shots") shots = atol(text);
+        else if (option == "-threads") threads = atoi(text);
+        else if (option == "-x") sim.target.x = value;
+        else if (option == "-z") sim.target.z = value;
+        else if (option == "-speed") sim.muzzleSpeed = value;
+        else if (option == "-speedSigma") study.muzzleSpeedSigma = value;
+        else if (option == "-elevationSigma") study.elevationSigma = value;
+        else if (option == "-directionSigma") study.directionSigma = value;
+        else if (option == "-windSigma") study.windSigma = value;
+        else if (option == "-drag") {
+            sim.drag->enabled = value > 0.0f;
+            sim.drag->k2 = value;
+        } else return false;
+        return true;
+    });
+    if (!isParsed) return 1;
+    if (shots < 1 || threads < 0) {
+        usage();
+        return 1;
+    }
+    
+    sim.aim();
+    if (!sim.isTargetInRange) {
+        cerr <<"target at " <<sim.target <<" is out of range at " <<sim.muzzleSpeed <<" m/s" <<endl;
+        return 1;
+    }
+    YAMPE::TaskScheduler scheduler(threads);
+    study.aimFrom(sim).run(shots, &scheduler);
+    
+    cout <<shots <<" shots at elevation " <<study.elevation <<", direction " <<study.direction
+         <<" on " <<scheduler.threadCount() <<" thread(s) in " <<study.seconds <<" s ("
+         <<shots / study.seconds <<" /s)" <<endl
+         <<"hit rate " <<100.0f * study.hitRate() <<" %, CEP " <<study.cep <<" m about the target, "
+         <<study.cepAboutMean <<" m about the mean point of impact " <<study.meanImpact;
+    if (study.lost > 0) cout <<", " <<study.lost <<" still in flight";
+    cout <<endl;
+    
+    ofstream out(heatmapFile.c_str());
+    if (!out) {
+        cerr <<"cannot write heatmap file " <<heatmapFile <<endl;
+        return 1;
+    }
+    out <<"x,z,impacts" <<endl;
+    for (int row = 0; row < study.heatmapSize; row++) {
+        for (int column = 0; column < study.heatmapSize; column++) {
+            ofVec3f centre = study.cellCentre(column, row);
+            out <<centre.x <<',' <<centre.z <<',' <<study.heatmap[row*study.heatmapSize + column] <<'\n';
+        }
+    }
+    return 0;
+}
+
+//========================================================================
+int main(int argc, char* argv[]) {
+    
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    if (string(argv[1]) == "-scaling") return scaling(argc, argv);
+    if (string(argv[1]) == "-replay") return replay(argc, argv);
+    if (string(argv[1]) == "-dispersion") return dispersion(argc, argv);
+    if (string(argv[1]) == "-trajectory") return trajectory(argc, argv);
+    if (string(argv[1]) == "-selftest") return selfTest(argc, argv);
+
+    string parametersFile = argv[1];
+    string resultsFile = argv[2];
+    long n = -1;
+    float dt = 0.01f;
+    float tMax = 60.0f;
+    int integrator = YAMPE::Integrator::EULER;
+    float tolerance = 1e-4f;
+    string trajectoriesFile;
+    bool isPacked = true;
+    bool isParsed = parseOptions(argc, argv, [&](const string& option, const char* value) {
+        if (option == "-n") n = atol(value);
+        else if (option == "-dt") dt = atof(value);
+        else if (option == "-tmax") tMax = atof(value);
+        else if (option == "-integrator") integrator = integratorType(value);
+        else if (option == "-tolerance") tolerance = atof(value);
+        else if (option == "-trajectories") trajectoriesFile = value;
+        else if (option == "-pack") isPacked = atoi(value) != 0;
+        else return false;
+        return true;
+    });
+    if (!isParsed) return 1;
+    if (dt <= 0.0f) {
+        cerr <<"expected a positive time step" <<endl;
+        return 1;
+    }
+    if (integrator < 0) {
+        usage();
+        return 1;
+    }
+    
+    vector<Shot> shots;
+    if (!readShots(parametersFile, shots)) {
+        cerr <<"cannot read parameter file " <<parametersFile <<endl;
+        return 1;
+    }
+    if (shots.empty()) {
+        cerr <<"no shots in parameter file " <<parametersFile <<endl;
+        return 1;
+    }
+    if (n < 0) n = shots.size();
+    
+    ofstream out(resultsFile.c_str());
+    if (!out) {
+        cerr <<"cannot write results file " <<resultsFile <<endl;
+        return 1;
+    }
+    out <<"shot,muzzleSpeed,elevation,direction,impactX,impactY,impactZ,flightTime,energyError" <<endl;
+    
+    CannonSimulation sim;
+    sim.setIntegrator(integrator);
+    if (integrator == YAMPE::Integrator::RK45) {
+        static_cast<YAMPE::DormandPrinceIntegrator&>(*sim.integrator).tolerance = tolerance;
+    }
+    YAMPE::TrajectoryWriter trajectories;
+    if (!trajectoriesFile.empty()) {
+        if (!trajectories.open(trajectoriesFile, 1 << 16, isPacked)) {
+            cerr <<"cannot write trajectory file " <<trajectoriesFile <<endl;
+            return 1;
+        }
+        sim.trajectories = &trajectories;
+    }
+    
+    long misses = 0;
+    long landed = 0;
+    double sumError = 0.0;
+    float maxError = 0.0f;
+    clock_t start = clock();
+    for (long i = 0; i < n; i++) {
+        const Shot& shot = shots[i % shots.size()];
+        sim.muzzleSpeed = shot.muzzleSpeed;
+        sim.elevation = shot.elevation;
+        sim.direction = shot.direction;
+        // restart the clock so that flight times keep full float precision
+        sim.t = 0.0f;
+        int targetHits = sim.targetHits;
+        sim.fire();
+        while (sim.gameState == CannonSimulation::FIRED && sim.t - sim.fireTime < tMax) {
+            sim.update(dt);
+        }
+        if (sim.gameState != CannonSimulation::HIT) {
+            misses++;
+            continue;
+        }
+        // shots stopped by the target box (left at the origin) do not reach the ground
+        if (sim.targetHits == targetHits) {
+            float error = sim.impactPoint.distance(exactImpact(sim));
+            sumError += error;
+            maxError = max(maxError, error);
+            landed++;
+        }
+        out <<i <<',' <<shot.muzzleSpeed <<',' <<shot.elevation <<',' <<shot.direction <<','
+            <<sim.impactPoint.x <<',' <<sim.impactPoint.y <<',' <<sim.impactPoint.z <<','
+            <<sim.flightTime <<',' <<sim.impactEnergyError <<'\n';
+    }
+    
+    double seconds = double(clock() - start) / CLOCKS_PER_SEC;
+    trajectories.close();
+    
+    cout <<sim.integrator->label() <<", dt = " <<dt <<": "
+         <<landed <<" ground impacts in " <<seconds <<" s CPU ("
+         <<(seconds > 0 ? landed / seconds : 0) <<" /s), impact error mean "
+         <<(landed > 0 ? sumError / landed : 0) <<" m, max " <<maxError <<" m" <<endl;
+    
+    if (!trajectoriesFile.empty()) {
+        cout <<trajectories.rows() <<" trajectory rows, " <<trajectories.bytesWritten / 1048576.0 <<" MB written to "
+             <<trajectoriesFile <<" (" <<trajectories.stalls <<" stalls)" <<endl;
+    }
+    if (misses > 0) {
+        cerr <<misses <<" shot(s) still in flight after " <<tMax <<" s" <<endl;
+    }
+    return 0;
+}
@@ -0,0 +1,494 @@
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <regex>
+#include <thread>
+#include <unistd.h>
+#include "ofMain.h"
+#include "YAMPE/Particle.h"
+#include "YAMPE/ParticleStore.h"
+#include "YAMPE/Integrator.h"
+#include "YAMPE/SpatialHash.h"
+#include "YAMPE/TelemetryChannel.h"
+#include "YAMPE/Trail.h"
+#include "Cannon/CannonSimulation.h"
+#include "Cannon/DispersionStudy.h"
+#include "Cannon/FiringTable.h"
+
+/**
+ * Keep a value the compiler would otherwise optimise away (as
+ * benchmark::DoNotOptimize).
+ */
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * Timing state handed to a benchmark: set up, then loop while keepRunning()
+ * is true. Only the loop is timed.
+ */
+class State {
+
+public:
+    const long iterations;
+    long itemsPerIteration;         ///< for items_per_second, if not 0
+
+    explicit State(long iterations) :
+        iterations(iterations), itemsPerIteration(0), m_remaining(iterations), m_isTiming(false) { }
+
+    bool keepRunning() {
+        if (!m_isTiming) {
+            m_isTiming = true;
+            m_cpuStart = clock();
+            m_start = std::chrono::steady_clock::now();
+        }
+        if (m_remaining-- > 0) return true;
+        realSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        cpuSeconds = double(clock() - m_cpuStart) / CLOCKS_PER_SEC;
+        return false;
+    }
+
+    double realSeconds;
+    double cpuSeconds;
+
+private:
+    long m_remaining;
+    bool m_isTiming;
+    std::chrono::steady_clock::time_point m_start;
+    clock_t m_cpuStart;
+};
+
+struct Benchmark {
+    string name;
+    std::function<void(State&)> run;
+};
+
+/**
+ * One timed run of a benchmark, in the units of the JSON report.
+ */
+struct Result {
+    string name;
+    string runName;
+    bool isAggregate;
+    int repetitionIndex;
+    long iterations;
+    double realTime;                ///< ns per iteration
+    double cpuTime;
+    double itemsPerSecond;
+};
+
+static vector<Benchmark> benchmarks;
+
+static void add(const string& name, const std::function<void(State&)>& run) {
+    Benchmark benchmark = {name, run};
+    benchmarks.push_back(benchmark);
+}
+
+//--------------------------------------------------------------
+// Benchmarks
+//--------------------------------------------------------------
+
+/**
+ * A store of n particles scattered over a 20 m square, moving in random directions.
+ */
+static void scatter(YAMPE::ParticleStore& particles, size_t n, float radius) {
+    ofSeedRandom(1);
+    particles.clear();
+    particles.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        particles.add()
+            .setPosition(ofVec3f(ofRandom(-10, 10), ofRandom(0, 10), ofRandom(-10, 10)))
+            .setVelocity(ofVec3f(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1)))
+            .setRadius(radius);
+    }
+}
+
+static void addIntegrator(YAMPE::Integrator::Type type, const string& name) {
+    add("Integrator/" + name + "/10000", [type](State& state) {
+        YAMPE::ParticleStore particles;
+        scatter(particles, 10000, 0.1f);
+        YAMPE::ForceRegistry forces;
+        forces.add(YAMPE::ForceGenerator::Ref(new YAMPE::GravityForceGenerator(ofVec3f(0, -CannonSimulation::GRAVITY, 0))));
+        forces.add(YAMPE::ForceGenerator::Ref(new YAMPE::DragForceGenerator(0.1f, 0.01f)));
+        YAMPE::Integrator::Ref integrator = YAMPE::Integrator::create(type);
+        float t = 0.0f;
+        state.itemsPerIteration = particles.size();
+        while (state.keepRunning()) {
+            integrator->step(particles, forces, t, 0.001f, 0, particles.size());
+            t += 0.001f;
+        }
+        keep(particles.px[0]);
+    });
+}
+
+static void registerBenchmarks() {
+
+    add("Particle/integrate", [](State& state) {
+        YAMPE::Particle particle;
+        particle.setVelocity(ofVec3f(1, 2, 3));
+        particle.acceleration.set(0, -CannonSimulation::GRAVITY, 0);
+        while (state.keepRunning()) {
+            particle.integrate(0.001f);
+            keep(particle.position);
+        }
+    });
+
+    add("Particle/toString", [](State& state) {
+        YAMPE::Particle particle;
+        particle.setPosition(ofVec3f(1, 2, 3)).setVelocity(ofVec3f(4, 5, 6));
+        while (state.keepRunning()) {
+            YAMPE::String text = particle.toString();
+            keep(text);
+        }
+    });
+
+    add("ParticleStore/integrate/10000", [](State& state) {
+        YAMPE::ParticleStore particles;
+        scatter(particles, 10000, 0.1f);
+        state.itemsPerIteration = particles.size();
+        while (state.keepRunning()) {
+            particles.integrate(0.001f);
+        }
+        keep(particles.px[0]);
+    });
+
+    addIntegrator(YAMPE::Integrator::EULER, "Euler");
+    addIntegrator(YAMPE::Integrator::VERLET, "Verlet");
+    addIntegrator(YAMPE::Integrator::RK4, "RK4");
+    addIntegrator(YAMPE::Integrator::RK45, "RK45");
+
+    add("Cannon/range", [](State& state) {
+        CannonSimulation sim;
+        float e = 0.0f;
+        while (state.keepRunning()) {
+            keep(sim.range(e));
+            e = e < 90.0f ? e + 0.5f : 0.0f;
+        }
+    });
+
+    // the elevation solved exactly, and looked up in a firing table
+    add("Cannon/calculateElevation", [](State& state) {
+        CannonSimulation sim;
+        float d = 0.0f;
+        while (state.keepRunning()) {
+            keep(sim.calculateElevation(d));
+            d = d < 16.0f ? d + 0.1f : 0.0f;
+        }
+    });
+    add("Cannon/calculateElevation/FiringTable", [](State& state) {
+        FiringTable table;
+        table.build(3.0f, 5.0f, 16, 1024, CannonSimulation::GRAVITY, CannonSimulation::MUZZLE_HEIGHT);
+        float d = 0.0f;
+        while (state.keepRunning()) {
+            keep(table.lookup(4.0f, d));
+            d = d < 16.0f ? d + 0.1f : 0.0f;
+        }
+    });
+
+    // the track as the app first kept it (128 particles shifted along every
+    // step), and as a ring of positions
+    add("Trail/shiftParticles/128", [](State& state) {
+        vector<YAMPE::Particle::Ref> balls;
+        for (int i = 0; i < 128; i++) balls.push_back(YAMPE::Particle::Ref(new YAMPE::Particle()));
+        ofVec3f position;
+        while (state.keepRunning()) {
+            for (int i = int(balls.size()) - 2; i >= 0; i--) {
+                balls[i + 1]->position = balls[i]->position;
+            }
+            balls[0]->position = position;
+            position.x += 0.01f;
+            keep(balls.back()->position);
+        }
+    });
+    add("Trail/sample/128", [](State& state) {
+        YAMPE::Trail trail(128);
+        ofVec3f position;
+        while (state.keepRunning()) {
+            trail.sample(position);
+            position.x += 0.01f;
+            keep(trail[trail.size() - 1]);
+        }
+    });
+
+    // three plot lines as the app first kept them (shifted along every step),
+    // and as telemetry channels
+    add("Telemetry/shiftVectors/1000", [](State& state) {
+        vector<float> heightLine(1000), velocityLine(1000), energyLine(1000);
+        float value = 0.0f;
+        while (state.keepRunning()) {
+            for (size_t i = 0; i + 1 < heightLine.size(); i++) {
+                heightLine[i] = heightLine[i + 1];
+                velocityLine[i] = velocityLine[i + 1];
+                energyLine[i] = energyLine[i + 1];
+            }
+            heightLine.back() = velocityLine.back() = energyLine.back() = value;
+            value += 1.0f;
+            keep(heightLine[0]);
+        }
+    });
+    add("Telemetry/append/1000", [](State& state) {
+        YAMPE::TelemetryChannel heightLine(1000), velocityLine(1000), energyLine(1000);
+        float value = 0.0f;
+        while (state.keepRunning()) {
+            heightLine.append(value);
+            velocityLine.append(value);
+            energyLine.append(value);
+            value += 1.0f;
+        }
+        keep(heightLine.written());
+    });
+
+    add("SpatialHash/findContacts/10000", [](State& state) {
+        YAMPE::ParticleStore particles;
+        scatter(particles, 10000, 0.1f);
+        YAMPE::SpatialHash hash;
+        std::vector<YAMPE::Contact> contacts;
+        hash.update(particles, 0, particles.size());
+        state.itemsPerIteration = particles.size();
+        while (state.keepRunning()) {
+            hash.findContacts(particles, contacts);
+            keep(contacts.size());
+        }
+    });
+
+    add("CannonSimulation/update/1000", [](State& state) {
+        CannonSimulation sim(1000);
+        sim.drag->enabled = true;
+        ofSeedRandom(1);
+        for (int i = 0; i < 1000; i++) {
+            sim.muzzleSpeed = ofRandom(3.0f, 5.0f);
+            sim.elevation = ofRandom(30.0f, 80.0f);
+            sim.direction = ofRandom(0.0f, 360.0f);
+            sim.fire();
+            // high enough that none land while timed
+            sim.projectiles.particles[sim.lastShot].setPosition(ofVec3f(ofRandom(-10, 10), 1e6f, ofRandom(-10, 10)));
+        }
+        state.itemsPerIteration = 1000;
+        while (state.keepRunning()) {
+            sim.update(0.001f);
+        }
+        keep(sim.t);
+    });
+
+    add("DispersionStudy/run/10000", [](State& state) {
+        CannonSimulation sim;
+        sim.target.set(5.0f, 0.0f, 3.0f);
+        sim.aim();
+        DispersionStudy study;
+        study.aimFrom(sim);
+        state.itemsPerIteration = 10000;
+        while (state.keepRunning()) {
+            study.run(10000);
+            keep(study.hits);
+        }
+    });
+}
+
+//--------------------------------------------------------------
+// Runner
+//--------------------------------------------------------------
+
+/**
+ * Run a benchmark with more and more iterations until it takes at least
+ * minTime, as Google Benchmark does.
+ */
+static Result measure(const Benchmark& benchmark, double minTime) {
+    long iterations = 1;
+    while (true) {
+        State state(iterations);
+        benchmark.run(state);
+        if (state.realSeconds >= minTime || iterations >= 1000000000L) {
+            Result result;
+            result.name = result.runName = benchmark.name;
+            result.isAggregate = false;
+            result.repetitionIndex = 0;
+            result.iterations = iterations;
+            result.realTime = 1e9 * state.realSeconds / iterations;
+            result.cpuTime = 1e9 * state.cpuSeconds / iterations;
+            result.itemsPerSecond = state.itemsPerIteration > 0 && state.realSeconds > 0
+                ? double(state.itemsPerIteration) * iterations / state.realSeconds : 0.0;
+            return result;
+        }
+        // aim for 1.4 times the minimum, growing by at most 10 times per attempt
+        double scale = state.realSeconds > 0 ? 1.4 * minTime / state.realSeconds : 10.0;
+        iterations = max(iterations + 1, long(iterations * min(10.0, scale)));
+    }
+}
+
+/**
+ * Mean, median and standard deviation of the repetitions of one benchmark.
+ */
+static void aggregate(const vector<Result>& runs, vector<Result>& results) {
+    const char* names[] = {"mean", "median", "stddev"};
+    for (int a = 0; a < 3; a++) {
+        Result result = runs[0];
+        result.name = runs[0].runName + "_" + names[a];
+        result.isAggregate = true;
+        vector<double> real, cpu, items;
+        for (size_t i = 0; i < runs.size(); i++) {
+            real.push_back(runs[i].realTime);
+            cpu.push_back(runs[i].cpuTime);
+            items.push_back(runs[i].itemsPerSecond);
+        }
+        vector<double>* values[] = {&real, &cpu, &items};
+        double statistic[3];
+        for (int v = 0; v < 3; v++) {
+            vector<double>& x = *values[v];
+            double mean = 0.0;
+            for (size_t i = 0; i < x.size(); i++) mean += x[i] / x.size();
+            if (a == 0) {
+                statistic[v] = mean;
+            } else if (a == 1) {
+                std::sort(x.begin(), x.end());
+                size_t n = x.size();
+                statistic[v] = n % 2 ? x[n/2] : 0.5 * (x[n/2 - 1] + x[n/2]);
+            } else {
+                double sum = 0.0;
+                for (size_t i = 0; i < x.size(); i++) sum += (x[i] - mean) * (x[i] - mean);
+                statistic[v] = x.size() > 1 ? sqrt(sum / (x.size() - 1)) : 0.0;
+            }
+        }
+        result.realTime = statistic[0];
+        result.cpuTime = statistic[1];
+        result.itemsPerSecond = statistic[2];
+        results.push_back(result);
+    }
+}
+
+static string escape(const string& text) {
+    string escaped;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\') escaped += '\\';
+        escaped += text[i];
+    }
+    return escaped;
+}
+
+/**
+ * Write the results in the JSON format of Google Benchmark, so that its
+ * tools (compare.py) can compare runs and implementations.
+ */
+static bool writeJson(const string& fileName, const char* executable, int repetitions, const vector<Result>& results) {
+    ofstream out(fileName.c_str());
+    if (!out) return false;
+
+    char hostName[256] = "";
+    gethostname(hostName, sizeof(hostName) - 1);
+    time_t now = time(NULL);
+    char date[64];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+    out <<"{\n  \"context\": {\n"
+        <<"    \"date\": \"" <<date <<"\",\n"
+        <<"    \"host_name\": \"" <<escape(hostName) <<"\",\n"
+        <<"    \"executable\": \"" <<escape(executable) <<"\",\n"
+        <<"    \"num_cpus\": " <<std::thread::hardware_concurrency() <<",\n"
+        <<"    \"mhz_per_cpu\": 0,\n"
+        <<"    \"cpu_scaling_enabled\": false,\n"
+#ifdef NDEBUG
+        <<"    \"library_build_type\": \"release\"\n"
+#else
+        <<"    \"library_build_type\": \"debug\"\n"
+#endif
+        <<"  },\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        out <<"    {\n"
+            <<"      \"name\": \"" <<escape(r.name) <<"\",\n"
+            <<"      \"run_name\": \"" <<escape(r.runName) <<"\",\n"
+            <<"      \"run_type\": \"" <<(r.isAggregate ? "aggregate" : "iteration") <<"\",\n"
+            <<"      \"repetitions\": " <<repetitions <<",\n";
+        if (r.isAggregate) {
+            out <<"      \"aggregate_name\": \"" <<r.name.substr(r.runName.size() + 1) <<"\",\n";
+        } else {
+            out <<"      \"repetition_index\": " <<r.repetitionIndex <<",\n";
+        }
+        out <<"      \"threads\": 1,\n"
+            <<"      \"iterations\": " <<r.iterations <<",\n"
+            <<"      \"real_time\": " <<r.realTime <<",\n"
+            <<"      \"cpu_time\": " <<r.cpuTime <<",\n"
+            <<"      \"time_unit\": \"ns\"";
+        if (r.itemsPerSecond > 0) out <<",\n      \"items_per_second\": " <<r.itemsPerSecond;
+        out <<"\n    }" <<(i + 1 < results.size() ? "," : "") <<"\n";
+    }
+    out <<"  ]\n}\n";
+    return bool(out);
+}
+
+static void usage() {
+    cerr <<"usage: bench [-filter regex] [-json results] [-min_time seconds] [-repetitions n]" <<endl
+         <<"  -filter      run only the benchmarks whose names match (default: all)" <<endl
+         <<"  -json        also write the results as Google Benchmark JSON" <<endl
+         <<"  -min_time    time each benchmark for at least this long (default 0.5)" <<endl
+         <<"  -repetitions run each benchmark n times and add mean, median and" <<endl
+         <<"               standard deviation (default 1)" <<endl
+         <<"  -list        list the benchmarks and exit" <<endl;
+}
+
+//========================================================================
+int main(int argc, char* argv[]) {
+
+    string filter = ".*";
+    string jsonFile;
+    double minTime = 0.5;
+    int repetitions = 1;
+    bool isListing = false;
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (option == "-list") {
+            isListing = true;
+        } else if (i + 1 < argc && option == "-filter") filter = argv[++i];
+        else if (i + 1 < argc && option == "-json") jsonFile = argv[++i];
+        else if (i + 1 < argc && option == "-min_time") minTime = atof(argv[++i]);
+        else if (i + 1 < argc && option == "-repetitions") repetitions = atoi(argv[++i]);
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (minTime <= 0.0 || repetitions < 1) {
+        usage();
+        return 1;
+    }
+
+    registerBenchmarks();
+    std::regex pattern(filter);
+
+    if (isListing) {
+        for (size_t b = 0; b < benchmarks.size(); b++) {
+            if (std::regex_search(benchmarks[b].name, pattern)) cout <<benchmarks[b].name <<endl;
+        }
+        return 0;
+    }
+
+    vector<Result> results;
+    printf("%-44s %15s %15s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+    for (size_t b = 0; b < benchmarks.size(); b++) {
+        const Benchmark& benchmark = benchmarks[b];
+        if (!std::regex_search(benchmark.name, pattern)) continue;
+        vector<Result> runs;
+        for (int r = 0; r < repetitions; r++) {
+            Result result = measure(benchmark, minTime);
+            result.repetitionIndex = r;
+            runs.push_back(result);
+            results.push_back(result);
+            printf("%-44s %12.1f ns %12.1f ns %12ld", result.name.c_str(), result.realTime, result.cpuTime, result.iterations);
+            if (result.itemsPerSecond > 0) printf(" items/s=%.4g", result.itemsPerSecond);
+            printf("\n");
+        }
+        if (repetitions > 1) {
+            size_t first = results.size();
+            aggregate(runs, results);
+            for (size_t i = first; i < results.size(); i++) {
+                printf("%-44s %12.1f ns %12.1f ns\n", results[i].name.c_str(), results[i].realTime, results[i].cpuTime);
+            }
+        }
+    }
+
+    if (!jsonFile.empty() && !writeJson(jsonFile, argv[0], repetitions, results)) {
+        cerr <<"cannot write results file " <<jsonFile <<endl;
+        return 1;
+    }
+    return 0;
+}
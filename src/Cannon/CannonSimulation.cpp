@@ -0,0 +1,452 @@
+/**
+ @file 		CannonSimulation.cpp
+ @practical
+ @brief		Window independent simulation of the cannon and its ball.
+ */
+
+#include "CannonSimulation.h"
+#include "ReplayLog.h"
+#include "../YAMPE/BinaryIO.h"
+#include "../YAMPE/EventLog.h"
+#include "../YAMPE/TrajectoryFile.h"
+#include "../YAMPE/Profiler.h"
+
+const float CannonSimulation::GRAVITY = 0.981f;
+const float CannonSimulation::MUZZLE_HEIGHT = 0.5f;
+const float CannonSimulation::TARGET_SIZE = 1.0f;
+const float CannonSimulation::TARGET_HEIGHT = 0.1f;
+
+CannonSimulation::CannonSimulation(size_t poolCapacity) :
+    gameState(START),
+    elevation(0.0f),
+    direction(0.0f),
+    muzzleSpeed(4.0f),
+    t(0.0f),
+    stepCount(0),
+    projectiles(poolCapacity),
+    scheduler(NULL),
+    lastShot(-1),
+    shotsFired(0),
+    targetHits(0),
+    isTargetInRange(true),
+    firingTable(NULL),
+    fireTime(0.0f),
+    flightTime(0.0f),
+    impactEnergyError(0.0f),
+    recorder(NULL),
+    trajectories(NULL),
+    m_hashedEnd(0)
+{
+    ball.setBodyColor(ofColor(0x666666));
+    
+    gravity.reset(new YAMPE::GravityForceGenerator(ofVec3f(0, -GRAVITY, 0)));
+    drag.reset(new YAMPE::DragForceGenerator(0.0f, 0.01f));
+    drag->enabled = false;
+    forces.add(gravity);
+    forces.add(drag);
+    
+    setIntegrator(YAMPE::Integrator::EULER);
+    
+    targetBox = collisions.addBox(ofVec3f(), ofVec3f());
+    seed(1);
+}
+
+void CannonSimulation::setIntegrator(int type) {
+    // keep the state of an adaptive integrator if it is not changing
+    if (integrator && type == integratorType) return;
+    integratorType = type;
+    integrator = YAMPE::Integrator::create(YAMPE::Integrator::Type(type));
+}
+
+void CannonSimulation::seed(uint32_t seed) {
+    randomSeed = seed;
+    randomState = seed != 0 ? seed : 0x9e3779b9u;
+}
+
+/**
+ * Xorshift generator: ofRandom shares the C library generator with the
+ * rest of the program, so its sequence cannot be replayed.
+ */
+float CannonSimulation::random() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return (randomState >> 8) * (1.0f/16777216.0f);
+}
+
+void CannonSimulation::reset() {
+
+    if (recorder) recorder->recordReset(*this);
+    
+    t = 0.0f;
+    
+    projectiles.releaseAll();
+    contacts.clear();
+    lastShot = -1;
+    shotsFired = 0;
+    targetHits = 0;
+    
+    float x = random() * 15.0f - 7.5f;
+    float z = random() * 15.0f - 7.5f;
+    target.set(x, 0, z);
+    ball.force = ofVec3f();
+    ball.acceleration = ofVec3f();
+    ball.velocity = ofVec3f();
+    ball.position = ofVec3f();
+}
+
+void CannonSimulation::update(float dt) {
+
+    if (dt <= 0) return;
+    if (recorder) recorder->recordStep(*this, dt);
+
+    // every ball in flight in one batch (free slots are skipped); the balls
+    // are packed at the start of the pool, so stop after the last of them
+    {
+        YAMPE_PROFILE_SCOPE("physics/integrate");
+        projectiles.saveState(projectiles.activeEnd());
+        integrator->advance(projectiles.particles, forces, t, dt, 0, projectiles.activeEnd(), scheduler);
+    }
+    findImpacts(dt);
+    t += dt;
+    stepCount++;
+    
+    findContacts();
+    measureEnergy();
+    logStates();
+    if (trajectories && trajectories->isOpen()) recordTrajectories();
+}
+
+/**
+ * Energy of every ball in flight against the energy it was fired with.
+ * The displayed ball keeps the energies of its last step in flight once
+ * it has landed.
+ */
+void CannonSimulation::measureEnergy() {
+    YAMPE_PROFILE_SCOPE("physics/energy");
+    ofVec3f g = gravity->enabled ? gravity->gravity : ofVec3f();
+    energy.measure(projectiles.particles, projectiles.launchEnergy, g, 0, projectiles.activeEnd());
+    
+    if (lastShot >= 0 && projectiles.isActive(lastShot)) {
+        projectiles.particles[lastShot].copyTo(ball);
+        ball.potentialEnergy = -ball.mass() * g.dot(ball.position);
+        ball.kineticEnergy = 0.5f * ball.mass() * ball.velocity.lengthSquared();
+        ball.errorEnergy = energy.energy[lastShot] - projectiles.launchEnergy[lastShot];
+    }
+}
+
+/**
+ * Solve for the moment within the step at which a ball entered its target
+ * or crossed the ground, so impacts do not depend on the step size.
+ */
+void CannonSimulation::findImpacts(float dt) {
+    YAMPE_PROFILE_SCOPE("physics/impacts");
+    for (size_t i = 0; i < projectiles.activeEnd(); i++) {
+        if (!projectiles.isActive(i)) continue;
+        if (!mayLand(projectiles.previousY[i], projectiles.particles.py[i])) continue;
+        
+        YAMPE::StepPath path = projectiles.stepPath(i, dt);
+        StepImpact impact = findImpact(path, projectiles.projectiles[i].target);
+        if (impact.time < 0) continue;
+        
+        ofVec3f point = path.position(impact.time);
+        if (!impact.hitTarget) point.y = 0;
+        land(i, t + impact.time, point, path.velocity(impact.time), impact.hitTarget);
+    }
+}
+
+StepImpact CannonSimulation::findImpact(const YAMPE::StepPath& path, const ofVec3f& target) {
+    const float top = 0.5f*TARGET_HEIGHT;
+    const float halfSize = 0.5f*TARGET_SIZE;
+    StepImpact impact = {-1.0f, false};
+    float y = path.position(path.duration()).y;
+    if (!mayLand(path.position(0.0f).y, y)) return impact;
+    
+    float hitTime = path.enterBox(target - ofVec3f(halfSize, top, halfSize), target + ofVec3f(halfSize, top, halfSize));
+    float groundTime = path.crossPlane(ofVec3f(0, 1, 0), 0.0f);
+    if (hitTime >= 0 && (groundTime < 0 || hitTime <= groundTime)) {
+        impact.time = hitTime;
+        impact.hitTarget = true;
+    } else if (groundTime >= 0) {
+        impact.time = groundTime;
+    } else if (y < 0) {
+        // no crossing on the path (round off at the start): clamp to the end of the step
+        impact.time = path.duration();
+    }
+    return impact;
+}
+
+bool CannonSimulation::mayLand(float startHeight, float endHeight) {
+    // gravity stops a ball dipping below the target and climbing back within a step
+    const float top = 0.5f*TARGET_HEIGHT;
+    return startHeight <= top || endHeight <= top;
+}
+
+/**
+ * The state of every ball still in flight, if anyone is watching.
+ */
+void CannonSimulation::logStates() {
+    YAMPE::EventLog& log = YAMPE::EventLog::instance();
+    if (!log.isRecording(YAMPE::EventLog::STATE)) return;
+    const YAMPE::ParticleStore& p = projectiles.particles;
+    for (size_t i = 0; i < projectiles.activeEnd(); i++) {
+        if (!projectiles.isActive(i)) continue;
+        log.log(YAMPE::EventLog::STATE, int(i), t, ofVec3f(p.px[i], p.py[i], p.pz[i]), ofVec3f(p.vx[i], p.vy[i], p.vz[i]));
+    }
+}
+
+/**
+ * The state of every ball still in flight, and its energy.
+ */
+void CannonSimulation::recordTrajectories() {
+    const YAMPE::ParticleStore& p = projectiles.particles;
+    ofVec3f g = gravity->enabled ? gravity->gravity : ofVec3f();
+    // stop at the last ball in flight rather than scanning the whole pool
+    size_t remaining = projectiles.activeCount();
+    for (size_t i = 0; remaining > 0; i++) {
+        if (!projectiles.isActive(i)) continue;
+        remaining--;
+        float mass = p.inverseMass[i] > 0.0f ? 1.0f/p.inverseMass[i] : 0.0f;
+        ofVec3f position(p.px[i], p.py[i], p.pz[i]);
+        ofVec3f velocity(p.vx[i], p.vy[i], p.vz[i]);
+        trajectories->append(t, int(i), position, velocity,
+                             -mass * g.dot(position), 0.5f * mass * velocity.lengthSquared());
+    }
+}
+
+/**
+ * Contacts between the balls still in flight, and with the current target.
+ */
+void CannonSimulation::findContacts() {
+    YAMPE_PROFILE_SCOPE("physics/contacts");
+    ofVec3f targetExtent(0.5f*TARGET_SIZE, 0.5f*TARGET_HEIGHT, 0.5f*TARGET_SIZE);
+    collisions.setBox(targetBox, target - targetExtent, target + targetExtent);
+    // slots released since the last update are covered too, so the hash lets go of them
+    collisions.update(projectiles.particles, 0, std::max(m_hashedEnd, projectiles.activeEnd()));
+    m_hashedEnd = projectiles.activeEnd();
+    collisions.findContacts(projectiles.particles, contacts, scheduler);
+}
+
+/**
+ * A ball has hit the ground or its target at the given time, point and
+ * velocity: record the impact and return its slot to the pool.
+ */
+void CannonSimulation::land(int slot, float time, const ofVec3f& impact, const ofVec3f& velocity, bool hitTarget) {
+    Projectile& projectile = projectiles.projectiles[slot];
+    
+    projectile.gameState = HIT;
+    projectile.hitTarget = hitTarget;
+    YAMPE::EventLog::instance().log(hitTarget ? YAMPE::EventLog::HIT : YAMPE::EventLog::LAND, slot, time,
+                                    impact, velocity);
+    if (hitTarget) targetHits++;
+    
+    if (slot == lastShot) {
+        flightTime = time - projectile.fireTime;
+        impactPoint = impact;
+        ofVec3f g = gravity->enabled ? gravity->gravity : ofVec3f();
+        impactEnergyError = YAMPE::EnergyMonitor::energyOf(impact, velocity, projectiles.particles[slot].mass(), g)
+                          - projectiles.launchEnergy[slot];
+        gameState = HIT;
+        
+        // the ball comes to rest where it landed
+        ball.position = impact;
+        ball.velocity = ofVec3f(0, 0, 0);
+        ball.acceleration = ofVec3f(0, 0, 0);
+    }
+    
+    projectiles.particles[slot].setPosition(impact);
+    projectiles.release(slot);
+}
+
+void CannonSimulation::aim() {
+    YAMPE_PROFILE_SCOPE("cannon/aim");
+    gameState = PLAY;
+    
+    ofVec3f direct = target.getNormalized();
+    //with the atan2 function the angle can be gathered by the vector data.
+    float angle = ofRadToDeg(atan2(direct.x,direct.z)) - 90.0f;
+    //correct angles below zero.
+    while (angle < 0) {
+        angle += 360;
+    }
+    direction = angle;
+    
+    // prefer the flat trajectory, unless that means firing into the ground
+    FiringSolution solution;
+    if (firingTable && firingTable->covers(muzzleSpeed, GRAVITY, MUZZLE_HEIGHT)) {
+        solution = firingTable->lookup(muzzleSpeed, target.length());
+    } else {
+        solution = solver().solve(target.length());
+    }
+    isTargetInRange = solution.inRange;
+    if (isTargetInRange) {
+        elevation = solution.low >= 0.0f ? solution.low : solution.high;
+    }
+}
+
+/**
+ * Fire control for the current muzzle speed.
+ */
+FiringSolver CannonSimulation::solver() const {
+    return FiringSolver(muzzleSpeed, GRAVITY, MUZZLE_HEIGHT);
+}
+
+/**
+ * The range function estimates the distance of the ball with the given angle.
+ * @param e this is the given angle in degrees.
+ */
+float CannonSimulation::range(float e) const {
+    return solver().range(e);
+}
+
+/**
+ * The elevation (in degrees) needed to hit a target at the given distance,
+ * preferring the flat trajectory. Returns 90 degrees (at the cannon) when
+ * the target is out of range; see FiringSolver for both solutions.
+ */
+float CannonSimulation::calculateElevation(float targetDistance) const {
+    FiringSolution solution = solver().solve(targetDistance);
+    if (!solution.inRange) return 90.0f;
+    return solution.low >= 0.0f ? solution.low : solution.high;
+}
+
+/**
+ * The fire function fires the cannon and sets the game state accordingly.
+ */
+void CannonSimulation::fire() {
+    YAMPE_PROFILE_SCOPE("cannon/fire");
+    if (recorder) recorder->recordFire(*this);
+    
+    int slot = projectiles.acquire();
+    if (slot < 0) {
+        ofLogWarning("CannonSimulation") <<"all " <<projectiles.capacity() <<" balls are in flight";
+        return;
+    }
+    
+    ofVec3f velocity = muzzleVelocity(muzzleSpeed, elevation, direction);
+    
+    ofVec3f muzzle(0, MUZZLE_HEIGHT, 0);
+    projectiles.particles[slot]
+        .setPosition(muzzle)
+        .setVelocity(velocity)
+        .setAcceleration(ofVec3f(0, 0, 0))
+        .setRadius(ball.radius);
+    projectiles.previousX[slot] = muzzle.x;
+    projectiles.previousY[slot] = muzzle.y;
+    projectiles.previousZ[slot] = muzzle.z;
+    projectiles.previousVX[slot] = velocity.x;
+    projectiles.previousVY[slot] = velocity.y;
+    projectiles.previousVZ[slot] = velocity.z;
+    
+    ofVec3f g = gravity->enabled ? gravity->gravity : ofVec3f();
+    projectiles.launchEnergy[slot] = YAMPE::EnergyMonitor::energyOf(muzzle, velocity, projectiles.particles[slot].mass(), g);
+    
+    Projectile& projectile = projectiles.projectiles[slot];
+    projectile.gameState = FIRED;
+    projectile.fireTime = t;
+    projectile.target = target;
+    projectile.hitTarget = false;
+    
+    YAMPE::EventLog::instance().log(YAMPE::EventLog::SPAWN, slot, t, muzzle, velocity);
+    
+    lastShot = slot;
+    shotsFired++;
+    projectiles.particles[slot].copyTo(ball);
+    ball.potentialEnergy = -ball.mass() * g.dot(muzzle);
+    ball.kineticEnergy = projectiles.launchEnergy[slot] - ball.potentialEnergy;
+    ball.errorEnergy = 0.0f;
+    
+    fireTime = t;
+    gameState = FIRED;
+}
+
+ofVec3f CannonSimulation::muzzleVelocity(float muzzleSpeed, float elevation, float direction) {
+    float rightDirection = direction + 90.0f;
+    float rightElevation = 90.0f - elevation;
+    
+    float cosElevation = cos(ofDegToRad(rightElevation));
+    float sinElevation = sin(ofDegToRad(rightElevation));
+    float sinDirection = sin(ofDegToRad(rightDirection));
+    float cosDirection = cos(ofDegToRad(rightDirection));
+    
+    float dirY = cosElevation * muzzleSpeed;
+    float dirX = sinDirection * sinElevation * muzzleSpeed;
+    float dirZ = cosDirection * sinElevation * muzzleSpeed;
+    return ofVec3f(dirX, dirY, dirZ);
+}
+
+void CannonSimulation::write(std::ostream& out) const {
+    using YAMPE::writeValue;
+    
+    // controls and forces
+    writeValue(out, int32_t(gameState));
+    writeValue(out, elevation);
+    writeValue(out, direction);
+    writeValue(out, muzzleSpeed);
+    writeValue(out, uint8_t(isTargetInRange));
+    writeValue(out, int32_t(integratorType));
+    const YAMPE::DormandPrinceIntegrator* adaptive = dynamic_cast<const YAMPE::DormandPrinceIntegrator*>(integrator.get());
+    writeValue(out, adaptive ? adaptive->suggestedStep : 0.0f);
+    writeValue(out, uint8_t(gravity->enabled));
+    writeValue(out, uint8_t(drag->enabled));
+    writeValue(out, drag->k1);
+    writeValue(out, drag->k2);
+    writeValue(out, drag->wind);
+    
+    // simulated state
+    writeValue(out, t);
+    writeValue(out, stepCount);
+    writeValue(out, randomSeed);
+    writeValue(out, randomState);
+    writeValue(out, target);
+    writeValue(out, int32_t(lastShot));
+    writeValue(out, int32_t(shotsFired));
+    writeValue(out, int32_t(targetHits));
+    writeValue(out, fireTime);
+    writeValue(out, flightTime);
+    writeValue(out, impactPoint);
+    writeValue(out, impactEnergyError);
+    writeValue(out, ball.position);
+    writeValue(out, ball.velocity);
+    writeValue(out, ball.acceleration);
+    writeValue(out, ball.potentialEnergy);
+    writeValue(out, ball.kineticEnergy);
+    writeValue(out, ball.errorEnergy);
+    projectiles.write(out);
+}
+
+bool CannonSimulation::read(std::istream& in) {
+    using YAMPE::readValue;
+    
+    int32_t state, type, last, fired, hits;
+    uint8_t inRange, gravityEnabled, dragEnabled;
+    float suggestedStep;
+    if (!(readValue(in, state) && readValue(in, elevation) && readValue(in, direction)
+          && readValue(in, muzzleSpeed) && readValue(in, inRange) && readValue(in, type)
+          && readValue(in, suggestedStep) && readValue(in, gravityEnabled) && readValue(in, dragEnabled)
+          && readValue(in, drag->k1) && readValue(in, drag->k2) && readValue(in, drag->wind))) return false;
+    gameState = state;
+    isTargetInRange = inRange != 0;
+    setIntegrator(type);
+    YAMPE::DormandPrinceIntegrator* adaptive = dynamic_cast<YAMPE::DormandPrinceIntegrator*>(integrator.get());
+    if (adaptive) adaptive->suggestedStep = suggestedStep;
+    gravity->enabled = gravityEnabled != 0;
+    drag->enabled = dragEnabled != 0;
+    
+    if (!(readValue(in, t) && readValue(in, stepCount) && readValue(in, randomSeed) && readValue(in, randomState)
+          && readValue(in, target) && readValue(in, last) && readValue(in, fired) && readValue(in, hits)
+          && readValue(in, fireTime) && readValue(in, flightTime) && readValue(in, impactPoint)
+          && readValue(in, impactEnergyError) && readValue(in, ball.position) && readValue(in, ball.velocity)
+          && readValue(in, ball.acceleration) && readValue(in, ball.potentialEnergy)
+          && readValue(in, ball.kineticEnergy) && readValue(in, ball.errorEnergy))) return false;
+    lastShot = last;
+    shotsFired = fired;
+    targetHits = hits;
+    if (!projectiles.read(in)) return false;
+    
+    // contacts are not saved, they follow from the positions
+    collisions.clear();
+    m_hashedEnd = 0;
+    findContacts();
+    return true;
+}
@@ -0,0 +1,140 @@
+/**
+ @file 		CannonSimulation.h
+ @practical
+ @brief		Window independent simulation of the cannon and its ball.
+ */
+
+#ifndef CANNON_SIMULATION_H
+#define CANNON_SIMULATION_H
+
+#include "ofMain.h"
+#include "../YAMPE/Particle.h"
+#include "../YAMPE/EnergyMonitor.h"
+#include "../YAMPE/ForceGenerator.h"
+#include "../YAMPE/Integrator.h"
+#include "../YAMPE/SpatialHash.h"
+#include "../YAMPE/TaskScheduler.h"
+#include "FiringSolver.h"
+#include "FiringTable.h"
+#include "ProjectilePool.h"
+
+class ReplayRecorder;
+namespace YAMPE {
+    class TrajectoryWriter;
+}
+
+/**
+ Where a ball landed within one integration step.
+ */
+struct StepImpact {
+    float time;             ///< time into the step (s), negative if the ball is still in flight
+    bool hitTarget;         ///< entered the target box rather than the ground
+};
+
+/**
+ The cannon simulation holds the cannon attributes, the ball and the target,
+ and advances them in time.
+ 
+ It makes no use of the window, the renderer or the frame clock, so it can
+ be driven by ofApp at frame rate or stepped as fast as possible by the
+ headless batch runner.
+ 
+ Everything it does is determined by its state, its own random generator
+ and the commands it is given, so a session can be recorded and replayed
+ exactly (see ReplayRecorder and ReplayPlayer).
+ */
+class CannonSimulation {
+    
+public:
+    static const float GRAVITY;             ///< magnitude of gravitational acceleration (m/s^2)
+    static const float MUZZLE_HEIGHT;       ///< height of the muzzle above the ground (m)
+    static const float TARGET_SIZE;         ///< width and depth of the target box (m)
+    static const float TARGET_HEIGHT;       ///< height of the target box, centred on the ground (m)
+    
+    // game state
+    enum GameState {START, PLAY, FIRED, HIT};
+    int gameState;
+    
+    // cannon attributes
+    float elevation;                        ///< rotation about the y-axis
+    float direction;                        ///< rotation about the z-axis
+    float muzzleSpeed;                      ///< magnitude of initial velocity
+    
+    float t;                                ///< simulation time
+    uint64_t stepCount;                     ///< updates since construction (not reset), to time replay events
+    uint32_t randomSeed;                    ///< seed of the generator that places the target
+    uint32_t randomState;
+    ProjectilePool projectiles;             ///< every ball in flight
+    YAMPE::ForceRegistry forces;            ///< forces acting on the balls in flight
+    ofPtr<YAMPE::GravityForceGenerator> gravity;
+    ofPtr<YAMPE::DragForceGenerator> drag;  ///< air resistance and wind (off by default)
+    YAMPE::Integrator::Ref integrator;      ///< scheme used to advance the balls in flight
+    int integratorType;                     ///< YAMPE::Integrator::Type of integrator
+    YAMPE::TaskScheduler* scheduler;        ///< if set, integration and contacts run in parallel chunks
+    YAMPE::SpatialHash collisions;          ///< broad phase over the balls in flight and the target (0.25 m cells)
+    std::vector<YAMPE::Contact> contacts;   ///< ball-ball and ball-target contacts after the last update
+    YAMPE::EnergyMonitor energy;            ///< energy of every ball in flight and its drift since firing
+    int targetBox;                          ///< index of the target in collisions
+    int lastShot;                           ///< pool slot of the most recent shot (-1 if none)
+    int shotsFired;
+    int targetHits;
+    YAMPE::Particle ball;                   ///< copy of the most recent shot (for display)
+    ofVec3f target;                         ///< target - note y coordinate is zero
+    bool isTargetInRange;                   ///< false if the last aim() could not reach the target
+    const FiringTable* firingTable;         ///< if set (and it covers muzzleSpeed), aim() looks up the elevation
+    
+    // result of the most recent shot
+    float fireTime;                         ///< simulation time at which the ball was fired
+    float flightTime;                       ///< time from firing to impact, exact within the step
+    ofVec3f impactPoint;                    ///< where the ball hit the ground or entered the target
+    float impactEnergyError;                ///< energy drift of the ball at impact (J)
+    
+    ReplayRecorder* recorder;               ///< if set, commands and periodic snapshots are recorded
+    YAMPE::TrajectoryWriter* trajectories;  ///< if set and open, every ball in flight is recorded every step
+    
+    CannonSimulation(size_t poolCapacity = 256);
+    
+    void reset();
+    void update(float dt);
+    void setIntegrator(int type);
+    
+    /// Restart the target generator from the given seed.
+    void seed(uint32_t seed);
+    /// Next number from the target generator, in [0, 1).
+    float random();
+    
+    /// Write the whole state, including controls and forces, for a snapshot.
+    void write(std::ostream& out) const;
+    /// Restore the state written by write() into a simulation with the same pool capacity.
+    bool read(std::istream& in);
+    
+    void aim();
+    void fire();
+    /// Velocity of a ball leaving the muzzle with the given speed, elevation and direction (degrees).
+    static ofVec3f muzzleVelocity(float muzzleSpeed, float elevation, float direction);
+    FiringSolver solver() const;
+    
+    /**
+     * The impact rule: the time within the step at which a ball on path
+     * entered the target box centred on target or, failing that, crossed
+     * the ground. A ball that ends the step below the ground without
+     * crossing it (round off at the start) lands at the end of the step.
+     */
+    static StepImpact findImpact(const YAMPE::StepPath& path, const ofVec3f& target);
+    /// False if a ball that starts and ends a step at these heights cannot have landed in it (a cheap test before findImpact).
+    static bool mayLand(float startHeight, float endHeight);
+    float range(float e) const;
+    float calculateElevation(float targetDistance) const;
+    
+private:
+    size_t m_hashedEnd;                     ///< pool slots given to collisions at the last update
+    
+    void findImpacts(float dt);
+    void measureEnergy();
+    void logStates();
+    void recordTrajectories();
+    void findContacts();
+    void land(int slot, float time, const ofVec3f& impact, const ofVec3f& velocity, bool hitTarget);
+};
+
+#endif
@@ -0,0 +1,251 @@
+/**
+ @file 		DispersionStudy.cpp
+ @practical
+ @brief		Monte Carlo dispersion of shots about an aim: hit rate, CEP and heatmap.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include "DispersionStudy.h"
+#include "../YAMPE/ForceGenerator.h"
+#include "../YAMPE/Integrator.h"
+#include "../YAMPE/StepPath.h"
+
+namespace {
+
+/**
+ * Drag with a wind of its own for each particle.
+ */
+class ShotDragForceGenerator : public YAMPE::ForceGenerator {
+
+public:
+    float k1, k2;
+    std::vector<float> windX, windZ;    ///< horizontal wind of each particle
+
+    ShotDragForceGenerator(float k1, float k2) : ForceGenerator("Drag"), k1(k1), k2(k2) { }
+
+    virtual void apply(YAMPE::ParticleStore& p, size_t begin, size_t end, float /*t*/) {
+        for (size_t i=begin; i<end; ++i) {
+            float ux = p.vx[i] - windX[i];
+            float uy = p.vy[i];
+            float uz = p.vz[i] - windZ[i];
+            float k = k1 + k2*sqrt(ux*ux + uy*uy + uz*uz);
+            p.fx[i] -= k*ux;
+            p.fy[i] -= k*uy;
+            p.fz[i] -= k*uz;
+        }
+    }
+
+    virtual const YAMPE::String toString() const {
+        std::ostringstream outs;
+        outs <<"k1 = " <<k1 <<"    k2 = " <<k2 <<"    Wind per shot";
+        return outs.str();
+    }
+};
+
+/**
+ * SplitMix64: one state per shot, seeded from the study seed and the shot
+ * index, so shots do not depend on which thread runs them.
+ */
+uint64_t nextRandom(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/// A pair of independent standard normal numbers (Box-Muller).
+void gaussians(uint64_t& state, float& a, float& b) {
+    double u = ((nextRandom(state) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    double v = (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+    double r = sqrt(-2.0 * log(u));
+    a = float(r * cos(TWO_PI * v));
+    b = float(r * sin(TWO_PI * v));
+}
+
+}
+
+DispersionStudy::DispersionStudy() :
+    muzzleSpeed(4.0f),
+    elevation(45.0f),
+    direction(0.0f),
+    muzzleSpeedSigma(0.05f),
+    elevationSigma(0.5f),
+    directionSigma(0.5f),
+    windSigma(0.0f),
+    isDragEnabled(false),
+    k1(0.0f),
+    k2(0.0f),
+    integratorType(YAMPE::Integrator::VERLET),
+    step(0.05f),
+    maxFlightTime(60.0f),
+    seed(1),
+    grain(1024),
+    heatmapSize(64),
+    heatmapExtent(4.0f),
+    shots(0),
+    hits(0),
+    lost(0),
+    cep(0.0f),
+    cepAboutMean(0.0f),
+    heatmapMaximum(0),
+    seconds(0.0)
+{ }
+
+DispersionStudy& DispersionStudy::aimFrom(const CannonSimulation& sim) {
+    muzzleSpeed = sim.muzzleSpeed;
+    elevation = sim.elevation;
+    direction = sim.direction;
+    target = sim.target;
+    isDragEnabled = sim.drag->enabled;
+    k1 = sim.drag->k1;
+    k2 = sim.drag->k2;
+    wind = sim.drag->wind;
+    return *this;
+}
+
+void DispersionStudy::run(long shots, YAMPE::TaskScheduler* scheduler) {
+    assert(shots > 0 && step > 0.0f && grain > 0 && "Expected shots and a positive step and grain.");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    this->shots = shots;
+    m_impactX.resize(shots);
+    m_impactZ.resize(shots);
+    m_hit.resize(shots);
+
+    // chunks write only their own shots, so they can run in any order
+    if (scheduler) {
+        scheduler->parallelFor(0, shots, grain, [this](size_t begin, size_t end) { runChunk(begin, end); });
+    } else {
+        for (size_t begin = 0; begin < size_t(shots); begin += grain) {
+            runChunk(begin, std::min(begin + grain, size_t(shots)));
+        }
+    }
+    summarise();
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Fire shots [begin, end) together and step them until every one has
+ * landed, recording whether each entered the target and where it crossed
+ * the ground.
+ */
+void DispersionStudy::runChunk(size_t begin, size_t end) {
+    size_t n = end - begin;
+
+    YAMPE::ParticleStore particles;
+    particles.reserve(n);
+    YAMPE::ForceRegistry forces;
+    forces.add(YAMPE::ForceGenerator::Ref(new YAMPE::GravityForceGenerator(ofVec3f(0, -CannonSimulation::GRAVITY, 0))));
+    ofPtr<ShotDragForceGenerator> drag(new ShotDragForceGenerator(k1, k2));
+    drag->windX.resize(n);
+    drag->windZ.resize(n);
+    if (isDragEnabled) forces.add(drag);
+    YAMPE::Integrator::Ref integrator = YAMPE::Integrator::create(YAMPE::Integrator::Type(integratorType));
+
+    ofVec3f muzzle(0, CannonSimulation::MUZZLE_HEIGHT, 0);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t state = seed ^ ((begin + i) * 0xd1b54a32d192ed03ull);
+        float speed, up, side, windX, windZ, unused;
+        gaussians(state, speed, up);
+        gaussians(state, side, windX);
+        gaussians(state, windZ, unused);
+        ofVec3f velocity = CannonSimulation::muzzleVelocity(muzzleSpeed + muzzleSpeedSigma*speed,
+                                                            elevation + elevationSigma*up,
+                                                            direction + directionSigma*side);
+        particles.add().setPosition(muzzle).setVelocity(velocity);
+        drag->windX[i] = wind.x + windSigma*windX;
+        drag->windZ[i] = wind.z + windSigma*windZ;
+        m_impactX[begin + i] = m_impactZ[begin + i] = NAN;
+        m_hit[begin + i] = false;
+    }
+
+    std::vector<ofVec3f> previousPosition(n), previousVelocity(n);
+    size_t inFlight = n;
+    for (float t = 0.0f; inFlight > 0 && t < maxFlightTime; t += step) {
+        for (size_t i = 0; i < n; i++) {
+            previousPosition[i].set(particles.px[i], particles.py[i], particles.pz[i]);
+            previousVelocity[i].set(particles.vx[i], particles.vy[i], particles.vz[i]);
+        }
+        integrator->step(particles, forces, t, step, 0, n);
+
+        for (size_t i = 0; i < n; i++) {
+            // landed shots have zero inverse mass
+            if (particles.inverseMass[i] == 0.0f) continue;
+            if (!CannonSimulation::mayLand(previousPosition[i].y, particles.py[i])) continue;
+
+            YAMPE::StepPath path(previousPosition[i], previousVelocity[i], particles[i].position(),
+                                 particles[i].velocity(), step);
+            StepImpact landing = CannonSimulation::findImpact(path, target);
+            if (landing.time < 0) continue;
+            if (landing.hitTarget) {
+                // a hit is scored where the shot enters the target, but the spread is measured
+                // where it crosses the ground plane through the target, as for a miss
+                m_hit[begin + i] = true;
+                landing.time = path.crossPlane(ofVec3f(0, 1, 0), 0.0f);
+                if (landing.time < 0) continue;
+            }
+            ofVec3f impact = path.position(landing.time);
+            m_impactX[begin + i] = impact.x;
+            m_impactZ[begin + i] = impact.z;
+            particles[i].setInverseMass(0.0f).setVelocity(ofVec3f::zero());
+            inFlight--;
+        }
+    }
+}
+
+/**
+ * Hit rate, mean point of impact, CEP and heatmap of the impacts.
+ */
+void DispersionStudy::summarise() {
+    hits = lost = 0;
+    double sumX = 0.0, sumZ = 0.0;
+    for (long i = 0; i < shots; i++) {
+        if (m_hit[i]) hits++;
+        if (std::isnan(m_impactX[i])) {
+            lost++;
+            continue;
+        }
+        sumX += m_impactX[i];
+        sumZ += m_impactZ[i];
+    }
+    long landed = shots - lost;
+    meanImpact = landed > 0 ? ofVec3f(sumX / landed, 0, sumZ / landed) : target;
+
+    // CEP is the median miss distance (on the ground) about each centre
+    std::vector<float> distance, distanceAboutMean;
+    distance.reserve(landed);
+    distanceAboutMean.reserve(landed);
+    heatmap.assign(heatmapSize * heatmapSize, 0);
+    float cell = cellSize();
+    for (long i = 0; i < shots; i++) {
+        if (std::isnan(m_impactX[i])) continue;
+        float dx = m_impactX[i] - target.x;
+        float dz = m_impactZ[i] - target.z;
+        distance.push_back(sqrt(dx*dx + dz*dz));
+        float mx = m_impactX[i] - meanImpact.x;
+        float mz = m_impactZ[i] - meanImpact.z;
+        distanceAboutMean.push_back(sqrt(mx*mx + mz*mz));
+
+        int column = int(floorf((dx + heatmapExtent) / cell));
+        int row = int(floorf((dz + heatmapExtent) / cell));
+        if (column >= 0 && column < heatmapSize && row >= 0 && row < heatmapSize) {
+            heatmap[row*heatmapSize + column]++;
+        }
+    }
+    cep = cepAboutMean = 0.0f;
+    if (landed > 0) {
+        std::nth_element(distance.begin(), distance.begin() + landed/2, distance.end());
+        cep = distance[landed/2];
+        std::nth_element(distanceAboutMean.begin(), distanceAboutMean.begin() + landed/2, distanceAboutMean.end());
+        cepAboutMean = distanceAboutMean[landed/2];
+    }
+    heatmapMaximum = heatmap.empty() ? 0 : *std::max_element(heatmap.begin(), heatmap.end());
+}
+
+ofVec3f DispersionStudy::cellCentre(int column, int row) const {
+    float cell = cellSize();
+    return ofVec3f(target.x - heatmapExtent + (column + 0.5f)*cell, 0,
+                   target.z - heatmapExtent + (row + 0.5f)*cell);
+}
@@ -0,0 +1,97 @@
+/**
+ @file 		DispersionStudy.h
+ @practical
+ @brief		Monte Carlo dispersion of shots about an aim: hit rate, CEP and heatmap.
+ */
+
+#ifndef DISPERSION_STUDY_H
+#define DISPERSION_STUDY_H
+
+#include <vector>
+#include <stdint.h>
+#include "ofMain.h"
+#include "../YAMPE/TaskScheduler.h"
+#include "CannonSimulation.h"
+
+/**
+ A dispersion study fires many shots about one aim, each with its muzzle
+ speed, elevation, direction and (horizontal) wind drawn from normal
+ distributions, and reports how likely the target is to be hit and how
+ the impacts are spread.
+
+ A shot that enters the target box is counted as a hit and flies on: the
+ spread (mean point of impact, CEP and heatmap) is measured where every
+ shot crosses the ground plane through the target, so it is not clamped
+ to the faces of the box.
+
+ Shots are simulated in independent chunks, each a ParticleStore stepped
+ by its own integrator with impacts solved within the step as in
+ CannonSimulation, so chunks run in parallel on a TaskScheduler. Every
+ shot draws its perturbations from the seed and its own index, so the
+ results are the same whatever the number of threads.
+
+ Wind only acts on a shot through drag, so windSigma has no effect when
+ drag is off.
+ */
+class DispersionStudy {
+
+public:
+    // aim and target (see aimFrom)
+    float muzzleSpeed;
+    float elevation;                ///< degrees
+    float direction;                ///< degrees
+    ofVec3f target;
+
+    // spread of each shot about the aim (one standard deviation)
+    float muzzleSpeedSigma;         ///< m/s
+    float elevationSigma;           ///< degrees
+    float directionSigma;           ///< degrees
+    float windSigma;                ///< of each horizontal component of the wind (m/s)
+
+    // physics
+    bool isDragEnabled;
+    float k1, k2;                   ///< drag coefficients
+    ofVec3f wind;                   ///< mean wind
+    int integratorType;             ///< YAMPE::Integrator::Type (Verlet: exact without drag, half the cost of RK4)
+    float step;                     ///< integration step (s); impacts are exact within it
+    float maxFlightTime;            ///< shots still in flight after this are lost (s)
+    uint64_t seed;
+    size_t grain;                   ///< shots per chunk
+
+    // heatmap of impacts on a square grid centred on the target
+    int heatmapSize;                ///< cells along each side
+    float heatmapExtent;            ///< distance from the target to the edge of the grid (m)
+
+    // results of the last run
+    long shots;
+    long hits;                      ///< shots that entered the target box
+    long lost;                      ///< shots still in flight after maxFlightTime
+    ofVec3f meanImpact;             ///< mean point of impact
+    float cep;                      ///< radius about the target within which half the shots land (m)
+    float cepAboutMean;             ///< radius about the mean point of impact within which half land (m)
+    std::vector<int> heatmap;       ///< impacts per cell, row by row from -z, column from -x
+    int heatmapMaximum;             ///< most impacts in one cell
+    double seconds;                 ///< wall clock time of the last run
+
+    DispersionStudy();
+
+    /// Take the aim, target and forces of a simulation.
+    DispersionStudy& aimFrom(const CannonSimulation& sim);
+
+    /// Fire the given number of shots and fill in the results.
+    void run(long shots, YAMPE::TaskScheduler* scheduler = NULL);
+
+    float hitRate() const { return shots > 0 ? float(hits) / shots : 0.0f; }
+    /// Centre of a heatmap cell on the ground.
+    ofVec3f cellCentre(int column, int row) const;
+    float cellSize() const { return 2.0f * heatmapExtent / heatmapSize; }
+
+private:
+    std::vector<float> m_impactX, m_impactZ;    ///< per shot crossing of the ground plane, NaN if lost
+    std::vector<char> m_hit;                    ///< per shot, entered the target box on the way
+
+    void runChunk(size_t begin, size_t end);
+    void summarise();
+};
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ @file 		FiringSolver.cpp
+ @practical
+ @brief		Closed form fire control: elevation needed to hit a target.
+ */
+
+#include <cmath>
+#include "FiringSolver.h"
+
+namespace {
+    const float DEGREES_PER_RADIAN = 57.29577951f;
+}
+
+float FiringSolver::range(float e) const {
+    float ux = muzzleSpeed * cos(e / DEGREES_PER_RADIAN);
+    float uy = muzzleSpeed * sin(e / DEGREES_PER_RADIAN);
+    return ( ux / gravity ) * ( uy + sqrt ( uy*uy + 2*gravity*launchHeight ) );
+}
+
+float FiringSolver::maximumRange() const {
+    return muzzleSpeed / gravity * sqrt(muzzleSpeed*muzzleSpeed + 2*gravity*launchHeight);
+}
+
+FiringSolution FiringSolver::solve(float distance) const {
+    FiringSolution solution;
+    solve(&distance, &solution, 1);
+    return solution;
+}
+
+/**
+ * One pass over the targets, sharing the constants of the quadratic. The
+ * loop is scalar: sqrt and atan are library calls the compiler does not
+ * vectorise.
+ */
+void FiringSolver::solve(const float* distances, FiringSolution* solutions, size_t n) const {
+    
+    const float k = gravity / (2*muzzleSpeed*muzzleSpeed);
+    const float h = launchHeight;
+    
+    for (size_t i=0; i<n; ++i) {
+        float d = fabs(distances[i]);
+        float a = k*d*d;
+        float discriminant = d*d - 4*a*(a - h);
+        
+        // q = d + sqrt(D) avoids cancellation: tan(high) = q/(2a), tan(low) = 2(a-h)/q.
+        float q = d + sqrt(discriminant > 0 ? discriminant : 0.0f);
+        float tanHigh = q / (2*a);
+        float tanLow = 2*(a - h) / q;
+        
+        solutions[i].inRange = discriminant >= 0;
+        // straight up (or down) reaches distance zero
+        solutions[i].high = d > 0 ? atan(tanHigh) * DEGREES_PER_RADIAN : 90.0f;
+        solutions[i].low = d > 0 ? atan(tanLow) * DEGREES_PER_RADIAN : -90.0f;
+    }
+}
@@ -0,0 +1,61 @@
+/**
+ @file 		FiringSolver.h
+ @practical
+ @brief		Closed form fire control: elevation needed to hit a target.
+ */
+
+#ifndef FIRING_SOLVER_H
+#define FIRING_SOLVER_H
+
+#include <cstddef>
+
+/**
+ Firing solution for one target distance. Targets beyond the maximum range
+ have no solution (inRange is false, angles are undefined).
+ 
+ A target within range can be hit by a flat (low) and a lofted (high)
+ trajectory; they coincide at maximum range. When the target is closer
+ than the muzzle height allows on a horizontal shot, the low solution is
+ below the horizontal (negative elevation).
+ */
+struct FiringSolution {
+    bool inRange;
+    float low;              ///< elevation of the flat trajectory (deg)
+    float high;             ///< elevation of the lofted trajectory (deg)
+};
+
+/**
+ A firing solver computes the elevations that land a ball fired at a given
+ muzzle speed from a given height at a given horizontal distance, under
+ constant gravity and without drag (the same model as CannonSimulation::range).
+ 
+ With T = tan(elevation) and a = g*d*d/(2*v*v) the landing condition is the
+ quadratic a*T*T - d*T + (a - h) = 0, so both solutions follow in closed
+ form with no iteration.
+ */
+class FiringSolver {
+    
+public:
+    float muzzleSpeed;      ///< magnitude of initial velocity (m/s)
+    float gravity;          ///< magnitude of gravitational acceleration (m/s^2)
+    float launchHeight;     ///< height of the muzzle above the ground (m)
+    
+    FiringSolver(float muzzleSpeed, float gravity, float launchHeight) :
+        muzzleSpeed(muzzleSpeed),
+        gravity(gravity),
+        launchHeight(launchHeight)
+    { }
+    
+    /// Horizontal distance travelled before hitting the ground when fired at elevation e (deg).
+    float range(float e) const;
+    
+    /// Greatest horizontal distance that can be reached.
+    float maximumRange() const;
+    
+    FiringSolution solve(float distance) const;
+    
+    /// Solve for n distances at once.
+    void solve(const float* distances, FiringSolution* solutions, size_t n) const;
+};
+
+#endif
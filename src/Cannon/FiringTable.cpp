@@ -0,0 +1,185 @@
+/**
+ @file 		FiringTable.cpp
+ @practical
+ @brief		Precomputed firing table with interpolated elevation lookup.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <cassert>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "FiringTable.h"
+
+FiringTable::FiringTable() :
+    m_header(NULL),
+    m_low(NULL),
+    m_high(NULL),
+    m_mapped(NULL),
+    m_mappedSize(0)
+{ }
+
+FiringTable::~FiringTable() {
+    unload();
+}
+
+void FiringTable::attach(const char* data) {
+    m_header = reinterpret_cast<const Header*>(data);
+    size_t n = size_t(m_header->speedCount) * m_header->distanceCount;
+    m_low = reinterpret_cast<const float*>(data + sizeof(Header));
+    m_high = m_low + n;
+}
+
+void FiringTable::unload() {
+    if (m_mapped) munmap(m_mapped, m_mappedSize);
+    m_mapped = NULL;
+    m_mappedSize = 0;
+    m_built.clear();
+    m_header = NULL;
+    m_low = m_high = NULL;
+}
+
+void FiringTable::build(float minSpeed, float maxSpeed, uint32_t speedCount, uint32_t distanceCount,
+                        float gravity, float launchHeight) {
+    
+    assert(speedCount >= 2 && distanceCount >= 2 && "Expected at least a 2x2 firing table");
+    assert(maxSpeed > minSpeed && "Expected a non-empty muzzle speed range");
+    
+    unload();
+    size_t n = size_t(speedCount) * distanceCount;
+    m_built.assign(sizeof(Header) + 2*n*sizeof(float), 0);
+    
+    Header* header = reinterpret_cast<Header*>(&m_built[0]);
+    memcpy(header->magic, "CFT2", 4);
+    header->speedCount = speedCount;
+    header->distanceCount = distanceCount;
+    header->minSpeed = minSpeed;
+    header->maxSpeed = maxSpeed;
+    header->gravity = gravity;
+    header->launchHeight = launchHeight;
+    header->maxError = 0.0f;
+    
+    float* low = reinterpret_cast<float*>(&m_built[sizeof(Header)]);
+    float* high = low + n;
+    
+    std::vector<float> distances(distanceCount);
+    std::vector<FiringSolution> solutions(distanceCount);
+    for (uint32_t i=0; i<speedCount; ++i) {
+        FiringSolver solver(minSpeed + (maxSpeed - minSpeed)*i/(speedCount - 1), gravity, launchHeight);
+        float maximumRange = solver.maximumRange();
+        for (uint32_t j=0; j<distanceCount; ++j) {
+            float w = float(j)/(distanceCount - 1);
+            distances[j] = maximumRange*(1.0f - w*w);
+        }
+        solver.solve(&distances[0], &solutions[0], distanceCount);
+        for (uint32_t j=0; j<distanceCount; ++j) {
+            low[i*distanceCount + j] = solutions[j].low;
+            high[i*distanceCount + j] = solutions[j].high;
+        }
+    }
+    attach(&m_built[0]);
+    
+    // Measure the worst error on a sub-grid of every cell, edges included:
+    // the error is not largest at the centre where the elevations curve
+    // fastest (the low one near the cannon), so one sample is not enough.
+    const uint32_t samples = 8;
+    float maxError = 0.0f;
+    for (uint32_t i=0; i+1<speedCount; ++i) {
+        for (uint32_t si=0; si<=samples; ++si) {
+            FiringSolver solver(minSpeed + (maxSpeed - minSpeed)*(i + float(si)/samples)/(speedCount - 1),
+                                gravity, launchHeight);
+            float maximumRange = solver.maximumRange();
+            for (uint32_t j=0; j+1<distanceCount; ++j) {
+                for (uint32_t sj=0; sj<=samples; ++sj) {
+                    float w = (j + float(sj)/samples)/(distanceCount - 1);
+                    float distance = maximumRange*(1.0f - w*w);
+                    FiringSolution exact = solver.solve(distance);
+                    FiringSolution approximate = lookup(solver.muzzleSpeed, distance);
+                    maxError = std::max(maxError, std::max(fabsf(exact.low - approximate.low),
+                                                           fabsf(exact.high - approximate.high)));
+                }
+            }
+        }
+    }
+    // Between samples the error can rise by about 1/samples^2 of its size
+    // (and by the rounding of the lookup), so widen it by that to a bound.
+    header->maxError = maxError*(1.0f + 1.0f/(samples*samples));
+}
+
+bool FiringTable::save(const std::string& fileName) const {
+    if (!isValid()) return false;
+    std::ofstream out(fileName.c_str(), std::ios::binary);
+    size_t n = size_t(m_header->speedCount) * m_header->distanceCount;
+    out.write(reinterpret_cast<const char*>(m_header), sizeof(Header));
+    out.write(reinterpret_cast<const char*>(m_low), n*sizeof(float));
+    out.write(reinterpret_cast<const char*>(m_high), n*sizeof(float));
+    return bool(out);
+}
+
+bool FiringTable::load(const std::string& fileName) {
+    unload();
+    
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    
+    const Header* header = static_cast<const Header*>(data);
+    size_t n = size_t(header->speedCount) * header->distanceCount;
+    if (memcmp(header->magic, "CFT2", 4) != 0
+        || header->speedCount < 2 || header->distanceCount < 2
+        || size_t(info.st_size) != sizeof(Header) + 2*n*sizeof(float)) {
+        munmap(data, info.st_size);
+        return false;
+    }
+    m_mapped = data;
+    m_mappedSize = info.st_size;
+    attach(static_cast<const char*>(data));
+    return true;
+}
+
+bool FiringTable::covers(float muzzleSpeed, float gravity, float launchHeight) const {
+    return isValid()
+        && muzzleSpeed >= m_header->minSpeed && muzzleSpeed <= m_header->maxSpeed
+        && gravity == m_header->gravity && launchHeight == m_header->launchHeight;
+}
+
+float FiringTable::interpolate(const float* values, float muzzleSpeed, float w) const {
+    const uint32_t ns = m_header->speedCount;
+    const uint32_t nd = m_header->distanceCount;
+    
+    float s = (muzzleSpeed - m_header->minSpeed)/(m_header->maxSpeed - m_header->minSpeed)*(ns - 1);
+    float d = w*(nd - 1);
+    uint32_t i = std::min(uint32_t(std::max(s, 0.0f)), ns - 2);
+    uint32_t j = std::min(uint32_t(std::max(d, 0.0f)), nd - 2);
+    float fs = s - i;
+    float fd = d - j;
+    
+    const float* row0 = values + i*nd + j;
+    const float* row1 = row0 + nd;
+    float v0 = row0[0] + fd*(row0[1] - row0[0]);
+    float v1 = row1[0] + fd*(row1[1] - row1[0]);
+    return v0 + fs*(v1 - v0);
+}
+
+FiringSolution FiringTable::lookup(float muzzleSpeed, float distance) const {
+    assert(isValid() && "Expected a built or loaded firing table");
+    
+    FiringSolution solution;
+    FiringSolver solver(muzzleSpeed, m_header->gravity, m_header->launchHeight);
+    float u = fabsf(distance)/solver.maximumRange();
+    solution.inRange = u <= 1.0f;
+    float w = sqrtf(solution.inRange ? 1.0f - u : 0.0f);
+    solution.low = interpolate(m_low, muzzleSpeed, w);
+    solution.high = interpolate(m_high, muzzleSpeed, w);
+    return solution;
+}
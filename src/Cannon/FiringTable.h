@@ -0,0 +1,82 @@
+/**
+ @file 		FiringTable.h
+ @practical
+ @brief		Precomputed firing table with interpolated elevation lookup.
+ */
+
+#ifndef FIRING_TABLE_H
+#define FIRING_TABLE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "FiringSolver.h"
+
+/**
+ A firing table holds the low and high elevations from FiringSolver on a
+ grid over muzzle speed and target distance, so that aiming is a table
+ lookup with bilinear interpolation rather than a solve.
+ 
+ The distance axis is w = sqrt(1 - d/maximumRange), which is uniform in
+ the region just short of maximum range where the elevations change
+ fastest; out of range targets (w undefined) are detected exactly. build()
+ measures the worst interpolation error against the exact solver on an 8x8
+ sub-grid of every cell, edges included, and stores it, widened to allow for
+ the error between samples, with the table.
+ 
+ Tables are saved as a small header followed by the two elevation arrays,
+ and load() memory-maps the file so that it is usable immediately without
+ parsing or copying.
+ */
+class FiringTable {
+    
+public:
+    struct Header {
+        char magic[4];              ///< "CFT2"
+        uint32_t speedCount;
+        uint32_t distanceCount;
+        float minSpeed;             ///< muzzle speed range covered (m/s)
+        float maxSpeed;
+        float gravity;
+        float launchHeight;
+        float maxError;             ///< bound on the interpolation error measured by build() (deg)
+    };
+    
+    FiringTable();
+    ~FiringTable();
+    
+    /// Fill the table from the exact solver and measure its interpolation error.
+    void build(float minSpeed, float maxSpeed, uint32_t speedCount, uint32_t distanceCount,
+               float gravity, float launchHeight);
+    
+    bool save(const std::string& fileName) const;
+    /// Memory-map a table saved by save(); returns false if missing or invalid.
+    bool load(const std::string& fileName);
+    void unload();
+    
+    bool isValid() const { return m_header != NULL; }
+    const Header& header() const { return *m_header; }
+    float maxError() const { return m_header ? m_header->maxError : 0.0f; }
+    
+    /// True if the table was built for the given speed and world.
+    bool covers(float muzzleSpeed, float gravity, float launchHeight) const;
+    
+    FiringSolution lookup(float muzzleSpeed, float distance) const;
+    
+private:
+    const Header* m_header;
+    const float* m_low;             ///< [speed][distance] low elevations
+    const float* m_high;            ///< [speed][distance] high elevations
+    
+    std::vector<char> m_built;      ///< storage of a built table
+    void* m_mapped;                 ///< storage of a loaded table
+    size_t m_mappedSize;
+    
+    void attach(const char* data);
+    float interpolate(const float* values, float muzzleSpeed, float w) const;
+    
+    FiringTable(const FiringTable&);
+    FiringTable& operator=(const FiringTable&);
+};
+
+#endif
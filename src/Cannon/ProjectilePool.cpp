@@ -0,0 +1,130 @@
+/**
+ @file 		ProjectilePool.cpp
+ @practical
+ @brief		Preallocated pool of cannon balls in flight.
+ */
+
+#include "ProjectilePool.h"
+#include "../YAMPE/BinaryIO.h"
+
+ProjectilePool::ProjectilePool(size_t capacity) :
+    m_activeEnd(0)
+{
+    assert(capacity > 0 && "Expected a projectile pool with positive capacity.");
+    
+    particles.reserve(capacity);
+    for (size_t i=0; i<capacity; ++i) {
+        particles.add().setInverseMass(0.0f);
+    }
+    previousX.assign(capacity, 0.0f);
+    previousY.assign(capacity, 0.0f);
+    previousZ.assign(capacity, 0.0f);
+    previousVX.assign(capacity, 0.0f);
+    previousVY.assign(capacity, 0.0f);
+    previousVZ.assign(capacity, 0.0f);
+    launchEnergy.assign(capacity, 0.0f);
+    
+    Projectile idle = {0, 0.0f, ofVec3f(), false};
+    projectiles.assign(capacity, idle);
+    m_active.assign(capacity, false);
+    
+    // hand out low slots first
+    m_free.reserve(capacity);
+    for (int i=int(capacity)-1; i>=0; --i) m_free.push_back(i);
+}
+
+int ProjectilePool::acquire() {
+    if (m_free.empty()) return -1;
+    int slot = m_free.back();
+    m_free.pop_back();
+    m_active[slot] = true;
+    m_activeEnd = std::max(m_activeEnd, size_t(slot) + 1);
+    particles[slot].setInverseMass(1.0f).clearForce();
+    return slot;
+}
+
+void ProjectilePool::release(int slot) {
+    assert(m_active[slot] && "Expected to release a projectile in flight.");
+    m_active[slot] = false;
+    // freeze the slot: zero inverse mass is skipped by integrate
+    particles[slot].setInverseMass(0.0f).setVelocity(ofVec3f::zero()).clearForce();
+    launchEnergy[slot] = 0.0f;
+    m_free.push_back(slot);
+    if (size_t(slot) + 1 == m_activeEnd) findActiveEnd();
+}
+
+void ProjectilePool::releaseAll() {
+    for (size_t i=0; i<capacity(); ++i) {
+        if (m_active[i]) release(i);
+    }
+}
+
+void ProjectilePool::findActiveEnd() {
+    while (m_activeEnd > 0 && !m_active[m_activeEnd - 1]) m_activeEnd--;
+}
+
+void ProjectilePool::saveState(size_t end) {
+    assert(end <= capacity() && "Expected slots within the pool.");
+    std::copy(particles.px.begin(), particles.px.begin() + end, previousX.begin());
+    std::copy(particles.py.begin(), particles.py.begin() + end, previousY.begin());
+    std::copy(particles.pz.begin(), particles.pz.begin() + end, previousZ.begin());
+    std::copy(particles.vx.begin(), particles.vx.begin() + end, previousVX.begin());
+    std::copy(particles.vy.begin(), particles.vy.begin() + end, previousVY.begin());
+    std::copy(particles.vz.begin(), particles.vz.begin() + end, previousVZ.begin());
+}
+
+YAMPE::StepPath ProjectilePool::stepPath(int slot, float dt) const {
+    return YAMPE::StepPath(ofVec3f(previousX[slot], previousY[slot], previousZ[slot]),
+                           ofVec3f(previousVX[slot], previousVY[slot], previousVZ[slot]),
+                           ofVec3f(particles.px[slot], particles.py[slot], particles.pz[slot]),
+                           ofVec3f(particles.vx[slot], particles.vy[slot], particles.vz[slot]),
+                           dt);
+}
+
+ofVec3f ProjectilePool::interpolatedPosition(int slot, float alpha) const {
+    return ofVec3f(previousX[slot] + alpha*(particles.px[slot] - previousX[slot]),
+                   previousY[slot] + alpha*(particles.py[slot] - previousY[slot]),
+                   previousZ[slot] + alpha*(particles.pz[slot] - previousZ[slot]));
+}
+
+void ProjectilePool::write(std::ostream& out) const {
+    particles.write(out);
+    YAMPE::writeArray(out, previousX); YAMPE::writeArray(out, previousY); YAMPE::writeArray(out, previousZ);
+    YAMPE::writeArray(out, previousVX); YAMPE::writeArray(out, previousVY); YAMPE::writeArray(out, previousVZ);
+    YAMPE::writeArray(out, launchEnergy);
+    for (size_t i=0; i<capacity(); ++i) {
+        const Projectile& projectile = projectiles[i];
+        YAMPE::writeValue(out, int32_t(projectile.gameState));
+        YAMPE::writeValue(out, projectile.fireTime);
+        YAMPE::writeValue(out, projectile.target);
+        YAMPE::writeValue(out, uint8_t(projectile.hitTarget));
+        YAMPE::writeValue(out, uint8_t(m_active[i]));
+    }
+    // the free list decides which slot the next shot takes
+    YAMPE::writeValue(out, uint32_t(m_free.size()));
+    YAMPE::writeArray(out, m_free);
+}
+
+bool ProjectilePool::read(std::istream& in) {
+    if (!particles.read(in)) return false;
+    if (!(YAMPE::readArray(in, previousX) && YAMPE::readArray(in, previousY) && YAMPE::readArray(in, previousZ)
+          && YAMPE::readArray(in, previousVX) && YAMPE::readArray(in, previousVY) && YAMPE::readArray(in, previousVZ)
+          && YAMPE::readArray(in, launchEnergy))) return false;
+    for (size_t i=0; i<capacity(); ++i) {
+        Projectile& projectile = projectiles[i];
+        int32_t gameState;
+        uint8_t hitTarget, active;
+        if (!(YAMPE::readValue(in, gameState) && YAMPE::readValue(in, projectile.fireTime) && YAMPE::readValue(in, projectile.target)
+              && YAMPE::readValue(in, hitTarget) && YAMPE::readValue(in, active))) return false;
+        projectile.gameState = gameState;
+        projectile.hitTarget = hitTarget != 0;
+        m_active[i] = active != 0;
+    }
+    uint32_t freeCount;
+    if (!YAMPE::readValue(in, freeCount) || freeCount > capacity()) return false;
+    m_free.resize(freeCount);
+    if (!YAMPE::readArray(in, m_free)) return false;
+    m_activeEnd = capacity();
+    findActiveEnd();
+    return true;
+}
@@ -0,0 +1,80 @@
+/**
+ @file 		ProjectilePool.h
+ @practical
+ @brief		Preallocated pool of cannon balls in flight.
+ */
+
+#ifndef PROJECTILE_POOL_H
+#define PROJECTILE_POOL_H
+
+#include "ofMain.h"
+#include "../YAMPE/ParticleStore.h"
+#include "../YAMPE/StepPath.h"
+
+/**
+ Book keeping for one shot, alongside its slot in the particle store.
+ */
+struct Projectile {
+    int gameState;                  ///< CannonSimulation::FIRED while in flight, HIT once landed
+    float fireTime;                 ///< simulation time at which it was fired
+    ofVec3f target;                 ///< target at the time it was fired
+    bool hitTarget;                 ///< landed on the target box
+};
+
+/**
+ A projectile pool holds a fixed number of cannon ball slots, allocated
+ once, with a free list so that firing and landing never allocate.
+ 
+ The simulated state of every slot lives in one ParticleStore and is
+ integrated in one batch. Free slots are given zero inverse mass so the
+ integration kernels skip them without branching.
+ 
+ Low slots are handed out first, so the balls in flight are packed at the
+ start of the pool and per step passes need only cover [0, activeEnd()),
+ whatever the capacity.
+ */
+class ProjectilePool {
+    
+private:
+    std::vector<int> m_free;        ///< stack of free slots
+    std::vector<bool> m_active;
+    size_t m_activeEnd;             ///< one past the highest slot in flight
+    
+    void findActiveEnd();
+    
+public:
+    YAMPE::ParticleStore particles;             ///< simulated state, one particle per slot
+    std::vector<float> previousX, previousY, previousZ;   ///< positions before the last integrate
+    std::vector<float> previousVX, previousVY, previousVZ; ///< velocities before the last integrate
+    std::vector<float> launchEnergy;            ///< energy each ball was fired with (zero for free slots)
+    std::vector<Projectile> projectiles;        ///< per shot state, one per slot
+    
+    explicit ProjectilePool(size_t capacity = 256);
+    
+    size_t capacity() const { return projectiles.size(); }
+    size_t activeCount() const { return capacity() - m_free.size(); }
+    bool isActive(int slot) const { return m_active[slot]; }
+    /// One past the highest slot in flight (0 if none are).
+    size_t activeEnd() const { return m_activeEnd; }
+    
+    /// Take a free slot, or return -1 if every slot is in flight.
+    int acquire();
+    /// Return a slot to the pool.
+    void release(int slot);
+    /// Return every slot to the pool.
+    void releaseAll();
+    
+    /// Remember the current positions and velocities of slots [0, end) (for interpolated drawing and event detection).
+    void saveState(size_t end);
+    /// Path of a slot through the last integration step of length dt.
+    YAMPE::StepPath stepPath(int slot, float dt) const;
+    /// Position of a slot interpolated between the last two integrations.
+    ofVec3f interpolatedPosition(int slot, float alpha) const;
+    
+    /// Write every slot, in flight or free, and the order of the free list.
+    void write(std::ostream& out) const;
+    /// Read the state written by write() from a pool of the same capacity.
+    bool read(std::istream& in);
+};
+
+#endif
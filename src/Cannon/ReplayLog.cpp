@@ -0,0 +1,349 @@
+/**
+ @file 		ReplayLog.cpp
+ @practical
+ @brief		Binary log of a cannon session, for deterministic replay and seeking.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "ReplayLog.h"
+#include "../YAMPE/BinaryIO.h"
+
+using YAMPE::writeValue;
+using YAMPE::readValue;
+
+//--------------------------------------------------------------
+// ReplayControls
+//--------------------------------------------------------------
+
+ReplayControls ReplayControls::of(const CannonSimulation& sim, float step) {
+    ReplayControls controls;
+    controls.step = step;
+    controls.muzzleSpeed = sim.muzzleSpeed;
+    controls.elevation = sim.elevation;
+    controls.direction = sim.direction;
+    controls.gameState = sim.gameState;
+    controls.isTargetInRange = sim.isTargetInRange;
+    controls.integratorType = sim.integratorType;
+    controls.gravityEnabled = sim.gravity->enabled;
+    controls.dragEnabled = sim.drag->enabled;
+    controls.k1 = sim.drag->k1;
+    controls.k2 = sim.drag->k2;
+    controls.wind = sim.drag->wind;
+    return controls;
+}
+
+void ReplayControls::applyTo(CannonSimulation& sim) const {
+    sim.muzzleSpeed = muzzleSpeed;
+    sim.elevation = elevation;
+    sim.direction = direction;
+    sim.gameState = gameState;
+    sim.isTargetInRange = isTargetInRange != 0;
+    sim.setIntegrator(integratorType);
+    sim.gravity->enabled = gravityEnabled != 0;
+    sim.drag->enabled = dragEnabled != 0;
+    sim.drag->k1 = k1;
+    sim.drag->k2 = k2;
+    sim.drag->wind = wind;
+}
+
+bool ReplayControls::operator==(const ReplayControls& other) const {
+    return step == other.step && muzzleSpeed == other.muzzleSpeed
+        && elevation == other.elevation && direction == other.direction
+        && gameState == other.gameState && isTargetInRange == other.isTargetInRange
+        && integratorType == other.integratorType && gravityEnabled == other.gravityEnabled
+        && dragEnabled == other.dragEnabled && k1 == other.k1 && k2 == other.k2 && wind == other.wind;
+}
+
+void ReplayControls::write(std::ostream& out) const {
+    writeValue(out, step);
+    writeValue(out, muzzleSpeed);
+    writeValue(out, elevation);
+    writeValue(out, direction);
+    writeValue(out, gameState);
+    writeValue(out, isTargetInRange);
+    writeValue(out, integratorType);
+    writeValue(out, gravityEnabled);
+    writeValue(out, dragEnabled);
+    writeValue(out, k1);
+    writeValue(out, k2);
+    writeValue(out, wind);
+}
+
+bool ReplayControls::read(std::istream& in) {
+    return readValue(in, step) && readValue(in, muzzleSpeed) && readValue(in, elevation)
+        && readValue(in, direction) && readValue(in, gameState) && readValue(in, isTargetInRange)
+        && readValue(in, integratorType) && readValue(in, gravityEnabled) && readValue(in, dragEnabled)
+        && readValue(in, k1) && readValue(in, k2) && readValue(in, wind);
+}
+
+//--------------------------------------------------------------
+// ReplayRecorder
+//--------------------------------------------------------------
+
+ReplayRecorder::ReplayRecorder() :
+    m_sim(NULL),
+    m_bytesWritten(0),
+    m_snapshotInterval(0),
+    m_lastSnapshot(0)
+{ }
+
+ReplayRecorder::~ReplayRecorder() {
+    close();
+}
+
+bool ReplayRecorder::open(const std::string& fileName, CannonSimulation& sim, float step, uint32_t snapshotInterval) {
+    assert(snapshotInterval > 0 && "Expected a positive snapshot interval.");
+    close();
+
+    m_out.open(fileName.c_str(), std::ios::binary | std::ios::trunc);
+    if (!m_out) {
+        ofLogError("ReplayRecorder") <<"cannot write replay log " <<fileName;
+        return false;
+    }
+    m_fileName = fileName;
+    m_snapshotInterval = snapshotInterval;
+
+    ReplayLog::Header header;
+    memcpy(header.magic, "CRP2", 4);
+    header.seed = sim.randomSeed;
+    header.capacity = uint32_t(sim.projectiles.capacity());
+    header.snapshotInterval = snapshotInterval;
+    writeValue(m_out, header);
+    m_bytesWritten = sizeof(header);
+
+    // the log starts from a snapshot, so recording can start at any time
+    recordSnapshot(sim, step);
+    m_sim = &sim;
+    sim.recorder = this;
+    return true;
+}
+
+void ReplayRecorder::close() {
+    if (!m_sim) return;
+    beginRecord();
+    endRecord(ReplayLog::END, m_sim->stepCount);
+    m_out.close();
+    m_sim->recorder = NULL;
+    m_sim = NULL;
+}
+
+void ReplayRecorder::recordReset(const CannonSimulation& sim) {
+    beginRecord();
+    endRecord(ReplayLog::RESET, sim.stepCount);
+}
+
+void ReplayRecorder::recordFire(const CannonSimulation& sim) {
+    beginRecord();
+    writeValue(m_payload, sim.muzzleSpeed);
+    writeValue(m_payload, sim.elevation);
+    writeValue(m_payload, sim.direction);
+    endRecord(ReplayLog::FIRE, sim.stepCount);
+}
+
+void ReplayRecorder::recordStep(const CannonSimulation& sim, float dt) {
+    ReplayControls controls = ReplayControls::of(sim, dt);
+    if (controls != m_controls) {
+        beginRecord();
+        controls.write(m_payload);
+        endRecord(ReplayLog::CONTROLS, sim.stepCount);
+        m_controls = controls;
+    }
+    if (sim.stepCount - m_lastSnapshot >= m_snapshotInterval) {
+        recordSnapshot(sim, dt);
+    }
+}
+
+void ReplayRecorder::recordSnapshot(const CannonSimulation& sim, float step) {
+    beginRecord();
+    writeValue(m_payload, step);
+    sim.write(m_payload);
+    endRecord(ReplayLog::SNAPSHOT, sim.stepCount);
+    m_out.flush();
+
+    m_lastSnapshot = sim.stepCount;
+    m_controls = ReplayControls::of(sim, step);
+}
+
+void ReplayRecorder::beginRecord() {
+    m_payload.str(std::string());
+}
+
+void ReplayRecorder::endRecord(ReplayLog::RecordType type, uint64_t step) {
+    const std::string& payload = m_payload.str();
+    writeValue(m_out, uint8_t(type));
+    writeValue(m_out, step);
+    writeValue(m_out, uint32_t(payload.size()));
+    m_out.write(payload.data(), payload.size());
+    m_bytesWritten += ReplayLog::RECORD_HEADER_SIZE + payload.size();
+}
+
+//--------------------------------------------------------------
+// ReplayPlayer
+//--------------------------------------------------------------
+
+ReplayPlayer::ReplayPlayer() :
+    verifiedSnapshots(0),
+    divergedSnapshots(0),
+    firstDivergence(0),
+    m_isComplete(false),
+    m_fireCount(0),
+    m_sim(NULL),
+    m_next(0),
+    m_step(0.0f)
+{ }
+
+bool ReplayPlayer::open(const std::string& fileName) {
+    m_data.clear();
+    m_records.clear();
+    m_snapshots.clear();
+    m_isComplete = false;
+    m_fireCount = 0;
+    m_sim = NULL;
+    verifiedSnapshots = divergedSnapshots = 0;
+
+    std::ifstream in(fileName.c_str(), std::ios::binary);
+    if (!in) return false;
+    m_data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (m_data.size() < sizeof(m_header)) return false;
+    memcpy(&m_header, &m_data[0], sizeof(m_header));
+    if (memcmp(m_header.magic, "CRP2", 4) != 0) return false;
+
+    // index the records, with the time each happened at; a record cut short
+    // by a crash ends the log
+    double time = 0.0;
+    float dt = 0.0f;
+    size_t offset = sizeof(m_header);
+    while (offset + ReplayLog::RECORD_HEADER_SIZE <= m_data.size()) {
+        Record record;
+        memcpy(&record.type, &m_data[offset], 1);
+        memcpy(&record.step, &m_data[offset + 1], 8);
+        memcpy(&record.size, &m_data[offset + 9], 4);
+        record.offset = offset + ReplayLog::RECORD_HEADER_SIZE;
+        if (record.offset + record.size > m_data.size()) break;
+
+        if (!m_records.empty()) time += double(record.step - m_records.back().step) * dt;
+        if ((record.type == ReplayLog::CONTROLS || record.type == ReplayLog::SNAPSHOT) && record.size >= sizeof(float)) {
+            memcpy(&dt, &m_data[record.offset], sizeof(float));
+        }
+        record.time = time;
+        record.dt = dt;
+
+        if (record.type == ReplayLog::SNAPSHOT) m_snapshots.push_back(m_records.size());
+        if (record.type == ReplayLog::FIRE) m_fireCount++;
+        if (record.type == ReplayLog::END) m_isComplete = true;
+        m_records.push_back(record);
+        offset = record.offset + record.size;
+    }
+    return !m_snapshots.empty();
+}
+
+uint64_t ReplayPlayer::firstStep() const {
+    return m_records.empty() ? 0 : m_records.front().step;
+}
+
+uint64_t ReplayPlayer::lastStep() const {
+    return m_records.empty() ? 0 : m_records.back().step;
+}
+
+double ReplayPlayer::timeAt(uint64_t step) const {
+    if (m_records.empty() || step <= firstStep()) return 0.0;
+    // last record at or before the step
+    size_t i = m_records.size();
+    while (i > 1 && m_records[i-1].step > step) i--;
+    const Record& record = m_records[i-1];
+    return record.time + double(step - record.step) * record.dt;
+}
+
+uint64_t ReplayPlayer::stepAt(double seconds) const {
+    if (m_records.empty() || seconds <= 0.0) return firstStep();
+    size_t i = m_records.size();
+    while (i > 1 && m_records[i-1].time > seconds) i--;
+    const Record& record = m_records[i-1];
+    if (record.dt <= 0.0f) return record.step;
+    return record.step + uint64_t((seconds - record.time) / record.dt + 0.5);
+}
+
+bool ReplayPlayer::seek(CannonSimulation& sim, uint64_t step) {
+    assert(sim.recorder == NULL && "Expected to play back into a simulation that is not recording.");
+    assert(sim.projectiles.capacity() == m_header.capacity && "Expected a simulation with the pool capacity of the log.");
+
+    // last snapshot at or before the step
+    size_t k = m_snapshots.size();
+    while (k > 0 && m_records[m_snapshots[k-1]].step > step) k--;
+    if (k == 0) return false;
+    size_t snapshot = m_snapshots[k-1];
+
+    // going forward within the same snapshot interval, carry on from where we are
+    bool isAhead = m_sim == &sim && sim.stepCount <= step && m_next > snapshot;
+    if (!isAhead) {
+        const Record& record = m_records[snapshot];
+        std::istream& in = payload(record);
+        if (!readValue(in, m_step) || !sim.read(in)) {
+            ofLogError("ReplayPlayer") <<"corrupt snapshot at step " <<record.step;
+            return false;
+        }
+        m_sim = &sim;
+        m_next = snapshot + 1;
+    }
+    play(sim, step);
+    return true;
+}
+
+void ReplayPlayer::play(CannonSimulation& sim, uint64_t step) {
+    assert(m_sim == &sim && "Expected to play forward from a seek.");
+    while (m_next < m_records.size() && m_records[m_next].step <= step) {
+        const Record& record = m_records[m_next++];
+        while (sim.stepCount < record.step) sim.update(m_step);
+        apply(sim, record);
+    }
+    while (sim.stepCount < step) sim.update(m_step);
+}
+
+std::istream& ReplayPlayer::payload(const Record& record) {
+    m_payload.clear();
+    m_payload.str(std::string(&m_data[0] + record.offset, record.size));
+    return m_payload;
+}
+
+void ReplayPlayer::apply(CannonSimulation& sim, const Record& record) {
+    std::istream& in = payload(record);
+    switch (record.type) {
+        case ReplayLog::RESET:
+            sim.reset();
+            break;
+        case ReplayLog::FIRE:
+            readValue(in, sim.muzzleSpeed);
+            readValue(in, sim.elevation);
+            readValue(in, sim.direction);
+            sim.fire();
+            break;
+        case ReplayLog::CONTROLS: {
+            ReplayControls controls;
+            if (controls.read(in)) {
+                controls.applyTo(sim);
+                m_step = controls.step;
+            }
+            break;
+        }
+        case ReplayLog::SNAPSHOT: {
+            // check the replay against the recorded state
+            float step;
+            readValue(in, step);
+            m_step = step;
+            m_state.str(std::string());
+            sim.write(m_state);
+            const std::string& state = m_state.str();
+            if (state.size() == record.size - sizeof(float)
+                && memcmp(state.data(), &m_data[record.offset + sizeof(float)], state.size()) == 0) {
+                verifiedSnapshots++;
+            } else {
+                if (divergedSnapshots == 0) firstDivergence = record.step;
+                divergedSnapshots++;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
@@ -0,0 +1,187 @@
+/**
+ @file 		ReplayLog.h
+ @practical
+ @brief		Binary log of a cannon session, for deterministic replay and seeking.
+ */
+
+#ifndef REPLAY_LOG_H
+#define REPLAY_LOG_H
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "CannonSimulation.h"
+
+/**
+ Everything a user can change between steps: the physics step, the cannon
+ controls and the force settings (and the game state, which aim() sets).
+ */
+struct ReplayControls {
+    float step;                     ///< physics step (s)
+    float muzzleSpeed;
+    float elevation;
+    float direction;
+    int32_t gameState;
+    uint8_t isTargetInRange;
+    int32_t integratorType;
+    uint8_t gravityEnabled;
+    uint8_t dragEnabled;
+    float k1, k2;
+    ofVec3f wind;
+
+    static ReplayControls of(const CannonSimulation& sim, float step);
+    void applyTo(CannonSimulation& sim) const;
+    bool operator==(const ReplayControls& other) const;
+    bool operator!=(const ReplayControls& other) const { return !(*this == other); }
+
+    void write(std::ostream& out) const;
+    bool read(std::istream& in);
+};
+
+/**
+ A replay log is a header followed by records, each a type, the step count
+ of the simulation it applies to and the size of its payload, so readers
+ can skip records they do not need:
+
+ - RESET and FIRE are the commands given to the simulation (a fire carries
+   the muzzle speed, elevation and direction it was given);
+ - CONTROLS records a change of step, controls or forces before a step;
+ - SNAPSHOT holds the step and the whole simulation state, written when
+   recording starts and every snapshotInterval steps after that;
+ - END marks a log that was closed cleanly.
+
+ Records are in the order they happened, and the records with the same
+ step count apply before that step is taken.
+ */
+namespace ReplayLog {
+    enum RecordType {RESET = 1, FIRE, CONTROLS, SNAPSHOT, END};
+
+    struct Header {
+        char magic[4];              ///< "CRP2"
+        uint32_t seed;              ///< CannonSimulation::randomSeed when recording started
+        uint32_t capacity;          ///< projectile pool capacity
+        uint32_t snapshotInterval;  ///< steps between snapshots
+    };
+
+    /// Bytes before the payload of a record: type, step count and payload size.
+    const size_t RECORD_HEADER_SIZE = 1 + 8 + 4;
+}
+
+/**
+ A replay recorder writes the commands given to a simulation, any change
+ of controls, and periodic snapshots of its state, to a replay log.
+
+ Once opened it is called by the simulation itself (see
+ CannonSimulation::recorder), so commands are recorded however they are
+ given. The log is flushed after every snapshot.
+ */
+class ReplayRecorder {
+
+public:
+    ReplayRecorder();
+    ~ReplayRecorder();
+
+    /// Start recording the simulation, which is about to be stepped by step, to a new log.
+    bool open(const std::string& fileName, CannonSimulation& sim, float step, uint32_t snapshotInterval = 600);
+    /// Mark the end of the log and stop recording.
+    void close();
+    bool isOpen() const { return m_sim != NULL; }
+    const std::string& fileName() const { return m_fileName; }
+    /// Size of the log so far (safe to read from any thread).
+    uint64_t bytesWritten() const { return m_bytesWritten.load(std::memory_order_relaxed); }
+
+    // called by CannonSimulation
+    void recordReset(const CannonSimulation& sim);
+    void recordFire(const CannonSimulation& sim);
+    /// Before the simulation takes a step of dt: record changed controls and, if due, a snapshot.
+    void recordStep(const CannonSimulation& sim, float dt);
+
+private:
+    CannonSimulation* m_sim;
+    std::ofstream m_out;
+    std::string m_fileName;
+    std::atomic<uint64_t> m_bytesWritten;
+    uint32_t m_snapshotInterval;
+    uint64_t m_lastSnapshot;        ///< step count of the last snapshot
+    ReplayControls m_controls;      ///< controls as last recorded
+    std::ostringstream m_payload;
+
+    void beginRecord();
+    void endRecord(ReplayLog::RecordType type, uint64_t step);
+    void recordSnapshot(const CannonSimulation& sim, float step);
+};
+
+/**
+ A replay player reads a replay log and plays it back into a simulation
+ (with no recorder), headless and as fast as it can be stepped.
+
+ seek() restores the last snapshot at or before the requested step and
+ plays forward from there, so any point of a long session is reached by
+ simulating at most one snapshot interval. Playing forward past a
+ snapshot compares the replayed state with it byte for byte, which checks
+ that the replay is exact.
+ */
+class ReplayPlayer {
+
+public:
+    int verifiedSnapshots;          ///< snapshots played past that matched
+    int divergedSnapshots;          ///< snapshots played past that did not
+    uint64_t firstDivergence;       ///< step count of the first that did not
+
+    ReplayPlayer();
+
+    /// Read and index a log; false if it is missing or not a replay log.
+    bool open(const std::string& fileName);
+    const ReplayLog::Header& header() const { return m_header; }
+    /// True if the log was closed cleanly (not cut short by a crash).
+    bool isComplete() const { return m_isComplete; }
+
+    uint64_t firstStep() const;
+    uint64_t lastStep() const;
+    int fireCount() const { return m_fireCount; }
+    int snapshotCount() const { return int(m_snapshots.size()); }
+    /// Physics step of the playback (s).
+    float step() const { return m_step; }
+
+    /// Time since recording started at the given step count (s).
+    double timeAt(uint64_t step) const;
+    /// Step count at the given time since recording started.
+    uint64_t stepAt(double seconds) const;
+
+    /// Bring the simulation to the given step count; false if the log starts after it.
+    bool seek(CannonSimulation& sim, uint64_t step);
+    /// Play forward from the current position to the given step count.
+    void play(CannonSimulation& sim, uint64_t step);
+
+private:
+    struct Record {
+        uint8_t type;
+        uint64_t step;
+        size_t offset;              ///< of the payload in m_data
+        uint32_t size;
+        double time;                ///< since recording started (s)
+        float dt;                   ///< physics step from this record on
+    };
+
+    std::vector<char> m_data;
+    ReplayLog::Header m_header;
+    std::vector<Record> m_records;
+    std::vector<size_t> m_snapshots;    ///< indices of the snapshot records
+    bool m_isComplete;
+    int m_fireCount;
+
+    const CannonSimulation* m_sim;      ///< simulation positioned by the last seek
+    size_t m_next;                      ///< next record to apply to it
+    float m_step;
+    std::ostringstream m_state;
+    std::istringstream m_payload;
+
+    /// Start reading the payload of a record.
+    std::istream& payload(const Record& record);
+    void apply(CannonSimulation& sim, const Record& record);
+};
+
+#endif
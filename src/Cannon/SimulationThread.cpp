@@ -0,0 +1,171 @@
+/**
+ @file 		SimulationThread.cpp
+ @practical
+ @brief		Cannon simulation stepped on its own thread, published as snapshots.
+ */
+
+#include <chrono>
+#include "SimulationThread.h"
+#include "../YAMPE/Profiler.h"
+
+float CannonSnapshot::alphaAt(double time) const {
+    return ofClamp(alpha + float(time - publishedAt)/step, 0.0f, 1.0f);
+}
+
+SimulationThread::SimulationThread() :
+    scheduler(1),
+    isRunning(true),
+    driftThreshold(0.01f),
+    isStepShrinking(false),
+    minimumStep(1.0f/1000.0f),
+    isDriftAlarm(false),
+    stepShrinks(0),
+    m_driftLimit(0.01f)
+{
+    sim.scheduler = &scheduler;
+    sim.trajectories = &trajectories;
+}
+
+double SimulationThread::now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SimulationThread::reset() {
+    sim.reset();
+    clock.reset();
+    trail.clear();
+    m_driftLimit = driftThreshold;
+    publish();
+}
+
+void SimulationThread::threadedFunction() {
+    YAMPE::Profiler::instance().nameThread("physics");
+    double last = now();
+    while (isThreadRunning()) {
+        double time = now();
+        float frameTime = float(time - last);
+        last = time;
+        
+        // take as many fixed physics steps as the time since the last pass allows
+        lock();
+        int steps = clock.advance(isRunning ? frameTime : 0.0f);
+        for (int i = 0; i < steps; i++) {
+            step();
+        }
+        publish();
+        float untilNextStep = clock.step - clock.accumulator;
+        unlock();
+        
+        std::this_thread::sleep_for(std::chrono::duration<float>(untilNextStep));
+    }
+}
+
+/**
+ * Advance the simulation by one physics step and record the history used
+ * for the track balls and the plots.
+ */
+void SimulationThread::step() {
+    YAMPE_PROFILE_SCOPE("physics/step");
+    
+    sim.update(clock.step);
+    const YAMPE::Particle& ball = sim.ball;
+    
+    // update the track "balls"
+    {
+        YAMPE_PROFILE_SCOPE("physics/trail");
+        trail.sample(ball.position);
+    }
+    
+    // append to the plot history (the oldest point drops off)
+    {
+        YAMPE_PROFILE_SCOPE("physics/telemetry");
+        heightLine.append(ball.position.y);
+        velocityLine.append(ball.position.x);
+        energyLine.append(ball.errorEnergy);
+        driftLine.append(sim.energy.relativeDrift());
+    }
+    
+    checkDrift();
+}
+
+/**
+ * Raise the alarm, and shrink the step if asked to, when the energy of the
+ * balls in flight has drifted too far from what they were fired with.
+ * The drift already made stays with those balls, so the alarm is raised
+ * again only once as much again has accumulated, or for later shots once
+ * every ball has landed.
+ */
+void SimulationThread::checkDrift() {
+    if (sim.projectiles.activeCount() == 0 || sim.drag->enabled) {
+        m_driftLimit = driftThreshold;
+        return;
+    }
+    float drift = sim.energy.relativeDrift();
+    if (drift <= m_driftLimit) return;
+    
+    isDriftAlarm = true;
+    m_driftLimit = drift + driftThreshold;
+    if (isStepShrinking && 0.5f*clock.step >= minimumStep) {
+        clock.setStep(0.5f*clock.step);
+        stepShrinks++;
+        ofLogWarning("SimulationThread") <<"energy drift " <<100.0f*drift <<"%, step shrunk to " <<1000.0f*clock.step <<" ms";
+    }
+}
+
+/**
+ * Copy what is drawn and displayed into the back snapshot and publish it.
+ * The snapshot's vectors keep their capacity, so this does not allocate
+ * once the pool has been full.
+ */
+void SimulationThread::publish() {
+    YAMPE_PROFILE_SCOPE("physics/publish");
+    CannonSnapshot& s = m_snapshots.back();
+    
+    s.publishedAt = now();
+    s.step = clock.step;
+    s.alpha = clock.alpha();
+    s.t = sim.t;
+    s.droppedTime = clock.droppedTime;
+    
+    s.gameState = sim.gameState;
+    s.elevation = sim.elevation;
+    s.direction = sim.direction;
+    s.target = sim.target;
+    s.isTargetInRange = sim.isTargetInRange;
+    s.maximumRange = sim.solver().maximumRange();
+    s.ball = sim.ball;
+    s.shotsFired = sim.shotsFired;
+    s.targetHits = sim.targetHits;
+    s.capacity = int(sim.projectiles.capacity());
+    s.contacts = int(sim.contacts.size());
+    s.pairTests = sim.collisions.pairTests;
+    
+    const ProjectilePool& pool = sim.projectiles;
+    s.previous.clear();
+    s.current.clear();
+    s.radius.clear();
+    s.color.clear();
+    for (size_t i = 0; i < pool.activeEnd(); i++) {
+        if (!pool.isActive(i)) continue;
+        s.previous.push_back(ofVec3f(pool.previousX[i], pool.previousY[i], pool.previousZ[i]));
+        s.current.push_back(ofVec3f(pool.particles.px[i], pool.particles.py[i], pool.particles.pz[i]));
+        s.radius.push_back(pool.particles.radius[i]);
+        s.color.push_back(sim.ball.getBodyColor());
+    }
+    
+    s.trail.clear();
+    for (size_t i = 0; i < trail.size(); i++) s.trail.push_back(trail[i]);
+    s.trailCapacity = int(trail.capacity());
+    s.isTrailInterpolated = trail.sampledLastStep() && trail.stepInterval == 1 && trail.distanceInterval <= 0.0f;
+    
+    s.integrator = sim.integrator->toString();
+    s.forceSeconds.resize(sim.forces.size());
+    s.forceAverageSeconds.resize(sim.forces.size());
+    for (size_t i = 0; i < sim.forces.size(); i++) {
+        const YAMPE::ForceRegistry::Entry& entry = sim.forces[i];
+        s.forceSeconds[i] = entry.lastSeconds;
+        s.forceAverageSeconds[i] = entry.steps > 0 ? float(entry.totalSeconds / entry.steps) : 0.0f;
+    }
+    
+    m_snapshots.publish();
+}
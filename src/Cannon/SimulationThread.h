@@ -0,0 +1,125 @@
+/**
+ @file 		SimulationThread.h
+ @practical
+ @brief		Cannon simulation stepped on its own thread, published as snapshots.
+ */
+
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include <atomic>
+#include "ofMain.h"
+#include "../YAMPE/FixedTimestep.h"
+#include "../YAMPE/TaskScheduler.h"
+#include "../YAMPE/TelemetryChannel.h"
+#include "../YAMPE/Trail.h"
+#include "../YAMPE/TrajectoryFile.h"
+#include "../YAMPE/TripleBuffer.h"
+#include "CannonSimulation.h"
+#include "ReplayLog.h"
+
+/**
+ Everything drawn or displayed of the simulation, as it was after one
+ physics step.
+ */
+struct CannonSnapshot {
+    double publishedAt;                     ///< SimulationThread::now() when published
+    float step;                             ///< physics step (s)
+    float alpha;                            ///< fraction of a step not yet simulated when published
+    float t;                                ///< simulation time
+    float droppedTime;                      ///< time dropped by the physics clock (s)
+
+    int gameState;
+    float elevation;
+    float direction;
+    ofVec3f target;
+    bool isTargetInRange;
+    float maximumRange;                     ///< reach of the cannon at its muzzle speed
+    YAMPE::Particle ball;                   ///< most recent shot
+    int shotsFired;
+    int targetHits;
+    int capacity;                           ///< size of the projectile pool
+    int contacts;
+    int pairTests;
+
+    // balls in flight
+    std::vector<ofVec3f> previous;          ///< position before the last step
+    std::vector<ofVec3f> current;           ///< position after the last step
+    std::vector<float> radius;
+    std::vector<ofColor> color;
+
+    std::vector<ofVec3f> trail;             ///< track of the last shot, newest first
+    int trailCapacity;                      ///< length of the track when full
+    bool isTrailInterpolated;               ///< trail sampled every step, so it can be interpolated
+
+    std::string integrator;                 ///< Integrator::toString()
+    std::vector<float> forceSeconds;        ///< time taken by each force generator in the last step
+    std::vector<float> forceAverageSeconds; ///< average time per step taken by each force generator
+
+    /// Fraction of a step to interpolate the balls by at the given time.
+    float alphaAt(double time) const;
+};
+
+/**
+ A simulation thread owns the cannon simulation and steps it in real time
+ on its own thread, at the rate of its fixed step clock rather than the
+ frame rate.
+
+ After each pass it publishes a CannonSnapshot through a triple buffer:
+ the render thread fetches the latest once per frame and draws from it
+ without locks, so a slow frame never holds up the physics and a slow
+ step never holds up a frame.
+
+ Changing the simulation (aim, fire, sliders, reset, starting or stopping
+ the recorders) must be done with the thread locked; the lock is held by the physics thread only while it takes
+ its steps, never while it sleeps.
+ */
+class SimulationThread : public ofThread {
+
+public:
+    CannonSimulation sim;
+    YAMPE::FixedTimestep clock;             ///< fixed physics step, independent of frame rate
+    YAMPE::TaskScheduler scheduler;         ///< threads sharing the physics phases
+    YAMPE::Trail trail;                     ///< track of the last shot
+    ReplayRecorder recorder;                ///< session log, if recording
+    YAMPE::TrajectoryWriter trajectories;   ///< every ball every step, if open
+    YAMPE::TelemetryChannel heightLine;     ///< plots, read without locks
+    YAMPE::TelemetryChannel velocityLine;
+    YAMPE::TelemetryChannel energyLine;
+    YAMPE::TelemetryChannel driftLine;      ///< drift of the energy of the balls in flight, relative to launch
+    std::atomic<bool> isRunning;            ///< false to pause the simulation
+
+    // energy drift alarm (gravity only: with drag on the balls lose energy for real)
+    float driftThreshold;                   ///< relative drift that raises the alarm
+    bool isStepShrinking;                   ///< halve the step when the alarm is raised
+    float minimumStep;                      ///< the step is not shrunk below this (s)
+    std::atomic<bool> isDriftAlarm;         ///< raised by the physics thread, cleared by the user
+    std::atomic<unsigned long> stepShrinks;
+
+    SimulationThread();
+
+    /// Clock that steps and snapshots are timed by (s).
+    static double now();
+
+    /// Reset the simulation and its track, and publish (thread locked or stopped).
+    void reset();
+
+    /// Pick up the latest snapshot (render thread, once per frame).
+    bool fetchSnapshot() { return m_snapshots.fetch(); }
+    /// Snapshot picked up by the last fetchSnapshot (render thread).
+    const CannonSnapshot& snapshot() const { return m_snapshots.front(); }
+
+protected:
+    void threadedFunction();
+
+private:
+    YAMPE::TripleBuffer<CannonSnapshot> m_snapshots;
+
+    float m_driftLimit;                     ///< drift that raises the alarm next
+
+    void step();
+    void checkDrift();
+    void publish();
+};
+
+#endif
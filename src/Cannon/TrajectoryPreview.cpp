@@ -0,0 +1,100 @@
+/**
+ @file 		TrajectoryPreview.cpp
+ @practical
+ @brief		Predicted arc and impact of the next shot, rebuilt only when the aim changes.
+ */
+
+#include "TrajectoryPreview.h"
+#include "../YAMPE/StepPath.h"
+
+bool TrajectoryPreview::Inputs::operator==(const Inputs& other) const {
+    return muzzleSpeed == other.muzzleSpeed && elevation == other.elevation && direction == other.direction
+        && target == other.target && integratorType == other.integratorType && step == other.step
+        && isGravityEnabled == other.isGravityEnabled && gravity == other.gravity
+        && isDragEnabled == other.isDragEnabled && k1 == other.k1 && k2 == other.k2 && wind == other.wind;
+}
+
+TrajectoryPreview::TrajectoryPreview() :
+    maxFlightTime(60.0f),
+    hasLanded(false),
+    hitsTarget(false),
+    flightTime(0.0f),
+    builds(0),
+    m_isValid(false)
+{ }
+
+TrajectoryPreview::Inputs TrajectoryPreview::inputsOf(const CannonSimulation& sim, float step) {
+    Inputs inputs;
+    inputs.muzzleSpeed = sim.muzzleSpeed;
+    inputs.elevation = sim.elevation;
+    inputs.direction = sim.direction;
+    inputs.target = sim.target;
+    inputs.integratorType = sim.integratorType;
+    inputs.step = step;
+    inputs.isGravityEnabled = sim.gravity->enabled;
+    inputs.gravity = sim.gravity->gravity;
+    inputs.isDragEnabled = sim.drag->enabled;
+    inputs.k1 = sim.drag->k1;
+    inputs.k2 = sim.drag->k2;
+    inputs.wind = sim.drag->wind;
+    return inputs;
+}
+
+bool TrajectoryPreview::update(const CannonSimulation& sim, float step) {
+    assert(step > 0.0f && "Expected a positive simulation step.");
+    Inputs inputs = inputsOf(sim, step);
+    if (m_isValid && inputs == m_inputs) return false;
+    m_inputs = inputs;
+    build();
+    m_isValid = true;
+    return true;
+}
+
+/**
+ * Fire one ball with the cached inputs and record its path until it lands.
+ */
+void TrajectoryPreview::build() {
+    builds++;
+
+    YAMPE::ParticleStore particles;
+    YAMPE::ForceRegistry forces;
+    if (m_inputs.isGravityEnabled) {
+        forces.add(YAMPE::ForceGenerator::Ref(new YAMPE::GravityForceGenerator(m_inputs.gravity)));
+    }
+    if (m_inputs.isDragEnabled) {
+        forces.add(YAMPE::ForceGenerator::Ref(new YAMPE::DragForceGenerator(m_inputs.k1, m_inputs.k2, m_inputs.wind)));
+    }
+    const float step = m_inputs.step;
+    YAMPE::Integrator::Ref integrator = YAMPE::Integrator::create(YAMPE::Integrator::Type(m_inputs.integratorType));
+
+    ofVec3f muzzle(0, CannonSimulation::MUZZLE_HEIGHT, 0);
+    ofVec3f velocity = CannonSimulation::muzzleVelocity(m_inputs.muzzleSpeed, m_inputs.elevation, m_inputs.direction);
+    particles.add().setPosition(muzzle).setVelocity(velocity);
+
+    points.clear();
+    points.push_back(muzzle);
+    hasLanded = hitsTarget = false;
+    for (float t = 0.0f; t < maxFlightTime; t += step) {
+        ofVec3f previousPosition = particles[0].position();
+        ofVec3f previousVelocity = particles[0].velocity();
+        integrator->step(particles, forces, t, step, 0, 1);
+        ofVec3f position = particles[0].position();
+
+        if (CannonSimulation::mayLand(previousPosition.y, position.y)) {
+            YAMPE::StepPath path(previousPosition, previousVelocity, position, particles[0].velocity(), step);
+            StepImpact landing = CannonSimulation::findImpact(path, m_inputs.target);
+            if (landing.time >= 0) {
+                impact = path.position(landing.time);
+                if (!landing.hitTarget) impact.y = 0;
+                hitsTarget = landing.hitTarget;
+                flightTime = t + landing.time;
+                hasLanded = true;
+                points.push_back(impact);
+                return;
+            }
+        }
+        points.push_back(position);
+    }
+    impact = points.back();
+    flightTime = maxFlightTime;
+}
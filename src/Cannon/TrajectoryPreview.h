@@ -0,0 +1,67 @@
+/**
+ @file 		TrajectoryPreview.h
+ @practical
+ @brief		Predicted arc and impact of the next shot, rebuilt only when the aim changes.
+ */
+
+#ifndef TRAJECTORY_PREVIEW_H
+#define TRAJECTORY_PREVIEW_H
+
+#include <vector>
+#include "ofMain.h"
+#include "CannonSimulation.h"
+
+/**
+ A trajectory preview is the path a ball fired now would follow: a
+ polyline from the muzzle to where it lands, simulated with the cannon's
+ forces and integrator at the step the simulation is advanced by, and
+ stopped exactly at the ground or the target (as in CannonSimulation::update),
+ so it lands where the shot will.
+
+ The arc is cached: update() compares the inputs that shape it (the aim,
+ the target, gravity, drag and wind, the integrator and its step) with
+ those it was built from and only simulates again when one has changed, so drawing a
+ preview costs nothing but the draw from one frame to the next.
+ */
+class TrajectoryPreview {
+
+public:
+    float maxFlightTime;            ///< the arc is cut off after this (s)
+
+    std::vector<ofVec3f> points;    ///< from the muzzle to the impact, one per step
+    ofVec3f impact;                 ///< where the ball lands or enters the target
+    bool hasLanded;                 ///< false if still in flight after maxFlightTime
+    bool hitsTarget;
+    float flightTime;               ///< s
+    unsigned long builds;           ///< times the arc has been simulated
+
+    TrajectoryPreview();
+
+    /// Simulate the arc again if the inputs of sim, or the step it is advanced by (s), have changed; true if it did.
+    bool update(const CannonSimulation& sim, float step);
+    /// Simulate the arc on the next update whatever the inputs.
+    void invalidate() { m_isValid = false; }
+
+private:
+    struct Inputs {
+        float muzzleSpeed, elevation, direction;
+        ofVec3f target;
+        int integratorType;
+        float step;
+        bool isGravityEnabled;
+        ofVec3f gravity;
+        bool isDragEnabled;
+        float k1, k2;
+        ofVec3f wind;
+
+        bool operator==(const Inputs& other) const;
+    };
+
+    Inputs m_inputs;
+    bool m_isValid;
+
+    static Inputs inputsOf(const CannonSimulation& sim, float step);
+    void build();
+};
+
+#endif
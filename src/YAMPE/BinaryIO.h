@@ -0,0 +1,48 @@
+/**
+ @file 		BinaryIO.h
+ @practical
+ @brief		Raw binary reading and writing of plain values and arrays.
+ */
+
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+
+namespace YAMPE {
+
+/**
+ Values are written in the byte order of the machine, with no padding, so
+ files are only portable between machines of the same endianness (every
+ platform openFrameworks runs on is little endian).
+ */
+template <typename T>
+void writeValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+    return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+/// Write the elements of an array (not its size).
+template <typename T>
+void writeArray(std::ostream& out, const std::vector<T>& values) {
+    if (!values.empty()) {
+        out.write(reinterpret_cast<const char*>(&values[0]), values.size()*sizeof(T));
+    }
+}
+
+/// Read values.size() elements into an array.
+template <typename T>
+bool readArray(std::istream& in, std::vector<T>& values) {
+    if (values.empty()) return bool(in);
+    return bool(in.read(reinterpret_cast<char*>(&values[0]), values.size()*sizeof(T)));
+}
+
+}	// namespace YAMPE
+
+#endif
@@ -0,0 +1,154 @@
+/**
+ @file 		EnergyMonitor.cpp
+ @practical
+ @brief		Vectorised energy accounting over a ParticleStore.
+ */
+
+#include "EnergyMonitor.h"
+#include "IntegrationKernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define YAMPE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+using namespace YAMPE;
+
+namespace {
+
+/// Running sums of a measure.
+struct Sums {
+    float potential;
+    float kinetic;
+    float launch;
+};
+
+void measureScalar(const ParticleStore& s, const float* launch, const ofVec3f& g, float* energy,
+                   size_t begin, size_t end, Sums& sums) {
+    for (size_t i=begin; i<end; ++i) {
+        float mass = s.inverseMass[i] > 0.0f ? 1.0f/s.inverseMass[i] : 0.0f;
+        float potential = -mass*(g.x*s.px[i] + g.y*s.py[i] + g.z*s.pz[i]);
+        float kinetic = 0.5f*mass*(s.vx[i]*s.vx[i] + s.vy[i]*s.vy[i] + s.vz[i]*s.vz[i]);
+        energy[i] = potential + kinetic;
+        sums.potential += potential;
+        sums.kinetic += kinetic;
+        sums.launch += launch[i];
+    }
+}
+
+#ifdef YAMPE_X86_SIMD
+
+float horizontalSum(__m128 v) {
+    float lanes[4];
+    _mm_storeu_ps(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+void measureSSE(const ParticleStore& s, const float* launch, const ofVec3f& g, float* energy,
+                size_t begin, size_t end, Sums& sums) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 gx = _mm_set1_ps(-g.x), gy = _mm_set1_ps(-g.y), gz = _mm_set1_ps(-g.z);
+    __m128 potentialSum = zero, kineticSum = zero, launchSum = zero;
+    size_t i = begin;
+    for (; i+4<=end; i+=4) {
+        __m128 im = _mm_loadu_ps(&s.inverseMass[i]);
+        // 1/0 is infinite, so the mass of an immovable particle is masked to zero
+        __m128 mass = _mm_and_ps(_mm_cmpgt_ps(im, zero), _mm_div_ps(one, im));
+        __m128 height = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, _mm_loadu_ps(&s.px[i])),
+                                              _mm_mul_ps(gy, _mm_loadu_ps(&s.py[i]))),
+                                   _mm_mul_ps(gz, _mm_loadu_ps(&s.pz[i])));
+        __m128 vx = _mm_loadu_ps(&s.vx[i]), vy = _mm_loadu_ps(&s.vy[i]), vz = _mm_loadu_ps(&s.vz[i]);
+        __m128 speed2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+        __m128 potential = _mm_mul_ps(mass, height);
+        __m128 kinetic = _mm_mul_ps(_mm_mul_ps(half, mass), speed2);
+        _mm_storeu_ps(&energy[i], _mm_add_ps(potential, kinetic));
+        potentialSum = _mm_add_ps(potentialSum, potential);
+        kineticSum = _mm_add_ps(kineticSum, kinetic);
+        launchSum = _mm_add_ps(launchSum, _mm_loadu_ps(&launch[i]));
+    }
+    sums.potential += horizontalSum(potentialSum);
+    sums.kinetic += horizontalSum(kineticSum);
+    sums.launch += horizontalSum(launchSum);
+    measureScalar(s, launch, g, energy, i, end, sums);
+}
+
+__attribute__((target("avx2")))
+float horizontalSum(__m256 v) {
+    return horizontalSum(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+__attribute__((target("avx2")))
+void measureAVX2(const ParticleStore& s, const float* launch, const ofVec3f& g, float* energy,
+                 size_t begin, size_t end, Sums& sums) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 gx = _mm256_set1_ps(-g.x), gy = _mm256_set1_ps(-g.y), gz = _mm256_set1_ps(-g.z);
+    __m256 potentialSum = zero, kineticSum = zero, launchSum = zero;
+    size_t i = begin;
+    for (; i+8<=end; i+=8) {
+        __m256 im = _mm256_loadu_ps(&s.inverseMass[i]);
+        __m256 mass = _mm256_and_ps(_mm256_cmp_ps(im, zero, _CMP_GT_OQ), _mm256_div_ps(one, im));
+        __m256 height = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, _mm256_loadu_ps(&s.px[i])),
+                                                    _mm256_mul_ps(gy, _mm256_loadu_ps(&s.py[i]))),
+                                      _mm256_mul_ps(gz, _mm256_loadu_ps(&s.pz[i])));
+        __m256 vx = _mm256_loadu_ps(&s.vx[i]), vy = _mm256_loadu_ps(&s.vy[i]), vz = _mm256_loadu_ps(&s.vz[i]);
+        __m256 speed2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)),
+                                      _mm256_mul_ps(vz, vz));
+        __m256 potential = _mm256_mul_ps(mass, height);
+        __m256 kinetic = _mm256_mul_ps(_mm256_mul_ps(half, mass), speed2);
+        _mm256_storeu_ps(&energy[i], _mm256_add_ps(potential, kinetic));
+        potentialSum = _mm256_add_ps(potentialSum, potential);
+        kineticSum = _mm256_add_ps(kineticSum, kinetic);
+        launchSum = _mm256_add_ps(launchSum, _mm256_loadu_ps(&launch[i]));
+    }
+    sums.potential += horizontalSum(potentialSum);
+    sums.kinetic += horizontalSum(kineticSum);
+    sums.launch += horizontalSum(launchSum);
+    measureSSE(s, launch, g, energy, i, end, sums);
+}
+
+#endif  // YAMPE_X86_SIMD
+
+}   // namespace
+
+
+EnergyMonitor::EnergyMonitor() :
+    potentialEnergy(0.0f),
+    kineticEnergy(0.0f),
+    launchEnergy(0.0f),
+    drift(0.0f),
+    measures(0)
+{ }
+
+float EnergyMonitor::energyOf(const ofVec3f& position, const ofVec3f& velocity, float mass, const ofVec3f& gravity) {
+    return -mass*gravity.dot(position) + 0.5f*mass*velocity.lengthSquared();
+}
+
+void EnergyMonitor::measure(const ParticleStore& store, const std::vector<float>& launch, const ofVec3f& gravity,
+                            size_t begin, size_t end) {
+
+    assert(end <= store.size() && end <= launch.size() && "Expected a measured range within the store");
+
+    if (energy.size() < store.size()) energy.resize(store.size(), 0.0f);
+
+    Sums sums = {0.0f, 0.0f, 0.0f};
+    switch (IntegrationKernel::active()) {
+#ifdef YAMPE_X86_SIMD
+        case IntegrationKernel::AVX2: measureAVX2(store, &launch[0], gravity, &energy[0], begin, end, sums); break;
+        case IntegrationKernel::SSE:  measureSSE(store, &launch[0], gravity, &energy[0], begin, end, sums); break;
+#endif
+        default:                      measureScalar(store, &launch[0], gravity, &energy[0], begin, end, sums); break;
+    }
+    potentialEnergy = sums.potential;
+    kineticEnergy = sums.kinetic;
+    launchEnergy = sums.launch;
+    drift = potentialEnergy + kineticEnergy - launchEnergy;
+    measures++;
+}
+
+float EnergyMonitor::relativeDrift() const {
+    return launchEnergy > 0.0f ? fabs(drift)/launchEnergy : 0.0f;
+}
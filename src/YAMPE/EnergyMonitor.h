@@ -0,0 +1,57 @@
+/**
+ @file 		EnergyMonitor.h
+ @practical
+ @brief		Vectorised energy accounting over a ParticleStore.
+ */
+
+#ifndef ENERGY_MONITOR_H
+#define ENERGY_MONITOR_H
+
+#include <vector>
+#include "ParticleStore.h"
+
+namespace YAMPE {
+
+/**
+ An energy monitor measures the mechanical energy of every particle in a
+ range of a ParticleStore, kinetic plus potential in a uniform gravity
+ field, and how far the total has drifted from the energy the particles
+ had when they were launched.
+
+ With gravity the only force acting, the exact motion conserves energy,
+ so the drift is the error of the integrator: it grows with the step and
+ with the order of the scheme. Other forces (drag) change the energy for
+ real, and their work is counted as drift.
+
+ measure() is a single pass over the store, 4 (SSE) or 8 (AVX2) particles
+ at a time with the kernel chosen by IntegrationKernel::active().
+ Immovable particles (inverse mass <= 0, the free slots of a pool) have
+ no energy: they are masked rather than skipped, and their launch energy
+ should be zero.
+ */
+class EnergyMonitor {
+
+public:
+    std::vector<float> energy;  ///< Total energy of each particle at the last measure (J).
+    float potentialEnergy;      ///< Summed over the range (J).
+    float kineticEnergy;
+    float launchEnergy;         ///< Energy the particles in the range started with (J).
+    float drift;                ///< Total energy less launch energy (J).
+    unsigned long measures;
+
+    EnergyMonitor();
+
+    /// Energy of one particle (J), with gravity the acceleration due to gravity.
+    static float energyOf(const ofVec3f& position, const ofVec3f& velocity, float mass, const ofVec3f& gravity);
+
+    /// Measure the particles in [begin, end), whose launch energies are launch[begin, end).
+    void measure(const ParticleStore& store, const std::vector<float>& launch, const ofVec3f& gravity,
+                 size_t begin, size_t end);
+
+    /// Drift as a fraction of the launch energy (0 if nothing was launched).
+    float relativeDrift() const;
+};
+
+}	// namespace YAMPE
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ @file 		EventLog.cpp
+ @practical
+ @brief		Binary log of particle events, written lock-free from the physics.
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include "EventLog.h"
+#include "Profiler.h"
+
+using namespace YAMPE;
+
+//--------------------------------------------------------------
+// EventLog
+//--------------------------------------------------------------
+
+const char* EventLog::typeNames[EventLog::TYPE_COUNT] = {"state", "spawn", "land", "hit"};
+
+EventLog::EventLog() :
+    m_types(0),
+    m_dropped(0),
+    m_history(HISTORY),
+    m_written(0),
+    m_isConsuming(false)
+{ }
+
+EventLog::~EventLog() {
+    stop();
+}
+
+EventLog& EventLog::instance() {
+    static EventLog log;
+    return log;
+}
+
+void EventLog::start() {
+    if (m_isConsuming) return;
+    m_isConsuming = true;
+    m_consumer = std::thread([this]() { consume(); });
+}
+
+void EventLog::stop() {
+    if (!m_isConsuming) return;
+    m_isConsuming = false;
+    m_consumer.join();
+    drain();
+}
+
+/**
+ * Ring of the calling thread, made on its first call.
+ */
+EventLog::Channel& EventLog::channel() {
+    static thread_local Channel* channel = NULL;
+    if (!channel) {
+        std::lock_guard<std::mutex> lock(m_channelsMutex);
+        m_channels.push_back(ofPtr<Channel>(new Channel()));
+        channel = m_channels.back().get();
+        channel->head = 0;
+        channel->tail = 0;
+        channel->thread = uint16_t(m_channels.size());
+    }
+    return *channel;
+}
+
+void EventLog::log(Type type, int id, float simulationTime, const ofVec3f& position, const ofVec3f& velocity) {
+    if (!isRecording(type)) return;
+
+    Channel& c = channel();
+    size_t head = c.head.load(std::memory_order_relaxed);
+    if (head - c.tail.load(std::memory_order_acquire) >= CHANNEL_CAPACITY) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    LogRecord& record = c.records[head % CHANNEL_CAPACITY];
+    record.time = Profiler::now();
+    record.simulationTime = simulationTime;
+    record.id = id;
+    record.type = uint16_t(type);
+    record.thread = c.thread;
+    record.position[0] = position.x;
+    record.position[1] = position.y;
+    record.position[2] = position.z;
+    record.velocity[0] = velocity.x;
+    record.velocity[1] = velocity.y;
+    record.velocity[2] = velocity.z;
+    // publish the record to the consumer
+    c.head.store(head + 1, std::memory_order_release);
+}
+
+void EventLog::consume() {
+    while (m_isConsuming) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+/**
+ * Move every record waiting in the rings into the history, one thread at
+ * a time (so the history is in order within each thread, not across them).
+ */
+void EventLog::drain() {
+    std::lock_guard<std::mutex> channelsLock(m_channelsMutex);
+    for (size_t i=0; i<m_channels.size(); ++i) {
+        Channel& c = *m_channels[i];
+        size_t tail = c.tail.load(std::memory_order_relaxed);
+        size_t head = c.head.load(std::memory_order_acquire);
+        if (head == tail) continue;
+
+        std::lock_guard<std::mutex> lock(m_historyMutex);
+        uint64_t written = m_written.load(std::memory_order_relaxed);
+        for (; tail != head; ++tail, ++written) {
+            m_history[written % HISTORY] = c.records[tail % CHANNEL_CAPACITY];
+        }
+        m_written.store(written, std::memory_order_release);
+        // hand the slots back to the thread
+        c.tail.store(tail, std::memory_order_release);
+    }
+}
+
+bool EventLog::record(uint64_t sequence, LogRecord& record) const {
+    std::lock_guard<std::mutex> lock(m_historyMutex);
+    uint64_t end = m_written.load(std::memory_order_relaxed);
+    if (sequence >= end || (end > HISTORY && sequence < end - HISTORY)) return false;
+    record = m_history[sequence % HISTORY];
+    return true;
+}
+
+void EventLog::format(const LogRecord& record, char* buffer, size_t size) {
+    const char* name = record.type < TYPE_COUNT ? typeNames[record.type] : "?";
+    snprintf(buffer, size, "%10.4f  %8.3f  #%-3d %-5s  p (%7.3f, %7.3f, %7.3f)  v (%7.3f, %7.3f, %7.3f)",
+             1e-9 * record.time, record.simulationTime, record.id, name,
+             record.position[0], record.position[1], record.position[2],
+             record.velocity[0], record.velocity[1], record.velocity[2]);
+}
+
+//--------------------------------------------------------------
+// EventLogView
+//--------------------------------------------------------------
+
+void EventLogView::update(const EventLog& log) {
+    if (types != m_types || id != m_id) {
+        m_types = types;
+        m_id = id;
+        m_scanned = 0;
+        m_matches.clear();
+    }
+
+    // forget records that have been overwritten
+    uint64_t written = log.written();
+    uint64_t oldest = written > EventLog::HISTORY ? written - EventLog::HISTORY : 0;
+    while (!m_matches.empty() && m_matches.front() < oldest) m_matches.pop_front();
+
+    unsigned mask = m_types;
+    int wanted = m_id;
+    std::deque<uint64_t>& matches = m_matches;
+    m_scanned = log.scan(m_scanned, [mask, wanted, &matches](uint64_t sequence, const LogRecord& record) {
+        if ((mask & (1u << record.type)) == 0) return;
+        if (wanted >= 0 && record.id != wanted) return;
+        matches.push_back(sequence);
+    });
+}
@@ -0,0 +1,150 @@
+/**
+ @file 		EventLog.h
+ @practical
+ @brief		Binary log of particle events, written lock-free from the physics.
+ */
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include "ofMain.h"
+
+namespace YAMPE {
+
+/**
+ One fixed-size record of the event log: what happened to which particle,
+ when, and where it was and how fast it was going.
+ */
+struct LogRecord {
+    int64_t time;               ///< wall clock (ns, see Profiler::now)
+    float simulationTime;       ///< s
+    int32_t id;                 ///< particle (slot)
+    uint16_t type;              ///< EventLog::Type
+    uint16_t thread;            ///< logging thread, numbered from 1 in order of first use
+    float position[3];
+    float velocity[3];
+};
+
+/**
+ The event log records particle events from the hot loop without
+ allocating, locking or formatting: each thread that logs owns a ring
+ of fixed-size records that only it writes and only the consumer thread
+ reads. The consumer moves the records, still binary, into a history of
+ the last HISTORY events, and text is only made when a record is shown
+ (see EventLogView and format).
+
+ Nothing is recorded until recording is turned on for a type, so code
+ that logs costs one atomic load per call when no-one is watching. A
+ thread whose ring is full drops its new records (see droppedRecords).
+ */
+class EventLog {
+
+public:
+    enum Type {STATE, SPAWN, LAND, HIT, TYPE_COUNT};
+    static const char* typeNames[TYPE_COUNT];
+
+    static const size_t CHANNEL_CAPACITY = 1 << 14;     ///< records per thread between drains
+    static const size_t HISTORY = 1 << 16;              ///< records kept for viewing
+
+    static EventLog& instance();
+    ~EventLog();
+
+    /// Start and stop the consumer thread (records pile up, then drop, without it).
+    void start();
+    void stop();
+
+    /// Record events of the types in the mask (bit per Type).
+    void setRecording(unsigned types) { m_types.store(types, std::memory_order_relaxed); }
+    unsigned recording() const { return m_types.load(std::memory_order_relaxed); }
+    bool isRecording(Type type) const { return (recording() & (1u << type)) != 0; }
+
+    /// Log one event from any thread (no allocation after the thread's first call).
+    void log(Type type, int id, float simulationTime, const ofVec3f& position, const ofVec3f& velocity);
+
+    /// Records logged and drained into the history so far, and dropped because a ring was full.
+    uint64_t written() const { return m_written.load(std::memory_order_acquire); }
+    unsigned long droppedRecords() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /// Copy a record of the history by its sequence number; false if it has been overwritten.
+    bool record(uint64_t sequence, LogRecord& record) const;
+    /// Call visit(sequence, record) for every record of the history from sequence on, under the lock.
+    template <typename Visit> uint64_t scan(uint64_t sequence, Visit visit) const;
+
+    /// Text of a record, written into buffer (no allocation).
+    static void format(const LogRecord& record, char* buffer, size_t size);
+
+private:
+    struct Channel {
+        LogRecord records[CHANNEL_CAPACITY];
+        std::atomic<size_t> head;       ///< next record to write (by its thread)
+        std::atomic<size_t> tail;       ///< next record to drain (by the consumer)
+        uint16_t thread;
+    };
+
+    std::atomic<unsigned> m_types;
+    std::atomic<unsigned long> m_dropped;
+
+    std::mutex m_channelsMutex;
+    std::vector<ofPtr<Channel> > m_channels;
+
+    mutable std::mutex m_historyMutex;
+    std::vector<LogRecord> m_history;   ///< ring of HISTORY records by sequence
+    std::atomic<uint64_t> m_written;
+
+    std::thread m_consumer;
+    std::atomic<bool> m_isConsuming;
+
+    EventLog();
+    EventLog(const EventLog&);
+    EventLog& operator=(const EventLog&);
+
+    Channel& channel();
+    void consume();
+    void drain();
+};
+
+template <typename Visit>
+uint64_t EventLog::scan(uint64_t sequence, Visit visit) const {
+    std::lock_guard<std::mutex> lock(m_historyMutex);
+    uint64_t end = m_written.load(std::memory_order_relaxed);
+    if (end > HISTORY && sequence < end - HISTORY) sequence = end - HISTORY;
+    for (; sequence < end; ++sequence) visit(sequence, m_history[sequence % HISTORY]);
+    return end;
+}
+
+/**
+ A filtered list of the records of the event log, for display. It keeps
+ only the sequence numbers of the records that match, and update() only
+ looks at records logged since the last call, so a view of a long log
+ costs little per frame; a row is copied (and formatted) when it is shown.
+ */
+class EventLogView {
+
+public:
+    unsigned types;             ///< mask of the types shown (bit per EventLog::Type)
+    int id;                     ///< particle shown, or -1 for all
+
+    EventLogView() : types(~0u), id(-1), m_types(~0u), m_id(-1), m_scanned(0) { }
+
+    /// Pick up new records (and start again if the filter has changed).
+    void update(const EventLog& log);
+    size_t size() const { return m_matches.size(); }
+    /// Copy the i-th matching record; false if it has been overwritten.
+    bool row(const EventLog& log, size_t i, LogRecord& record) const { return log.record(m_matches[i], record); }
+
+private:
+    unsigned m_types;
+    int m_id;
+    uint64_t m_scanned;
+    std::deque<uint64_t> m_matches;
+};
+
+}	// namespace YAMPE
+
+#endif
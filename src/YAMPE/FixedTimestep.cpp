@@ -0,0 +1,48 @@
+/**
+ @file 		FixedTimestep.cpp
+ @practical
+ @brief		Fixed step physics clock with an accumulator.
+ */
+
+#include <cassert>
+#include "FixedTimestep.h"
+
+using namespace YAMPE;
+
+FixedTimestep& FixedTimestep::setStep(float step) {
+    assert(step > 0.0f && "Expected a positive physics step.");
+    this->step = step;
+    return *this;
+}
+
+FixedTimestep& FixedTimestep::setMaxSubsteps(int maxSubsteps) {
+    assert(maxSubsteps > 0 && "Expected at least one substep per frame.");
+    this->maxSubsteps = maxSubsteps;
+    return *this;
+}
+
+int FixedTimestep::advance(float frameTime) {
+    if (frameTime > 0.0f) accumulator += frameTime;
+    
+    int steps = int(accumulator/step);
+    if (steps > maxSubsteps) {
+        // Drop whole steps we cannot afford, but keep the fractional part
+        // so that interpolation stays continuous.
+        droppedTime += (steps - maxSubsteps)*step;
+        accumulator -= (steps - maxSubsteps)*step;
+        steps = maxSubsteps;
+    }
+    accumulator -= steps*step;
+    if (accumulator < 0.0f) accumulator = 0.0f;
+    return steps;
+}
+
+float FixedTimestep::alpha() const {
+    float alpha = accumulator/step;
+    return alpha < 1.0f ? alpha : 1.0f;
+}
+
+void FixedTimestep::reset() {
+    accumulator = 0.0f;
+    droppedTime = 0.0f;
+}
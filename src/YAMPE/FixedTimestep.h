@@ -0,0 +1,51 @@
+/**
+ @file 		FixedTimestep.h
+ @practical
+ @brief		Fixed step physics clock with an accumulator.
+ */
+
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+namespace YAMPE {
+
+/**
+ A fixed timestep clock turns variable frame times into a whole number of
+ physics steps of constant size.
+ 
+ Frame time is added to an accumulator and consumed in steps of size step.
+ At most maxSubsteps are taken per frame; time beyond that is dropped (and
+ counted) so that a slow frame cannot make the next one slower still. The
+ remainder left in the accumulator gives the interpolation factor alpha()
+ between the last two physics states for rendering.
+ */
+class FixedTimestep {
+    
+public:
+    float step;                 ///< Physics step size (s).
+    int maxSubsteps;            ///< Maximum number of steps per frame.
+    float accumulator;          ///< Frame time not yet simulated (s).
+    float droppedTime;          ///< Total time dropped due to the substep cap (s).
+    
+    FixedTimestep(float step = 1.0f/120.0f, int maxSubsteps = 8) :
+        step(step),
+        maxSubsteps(maxSubsteps),
+        accumulator(0.0f),
+        droppedTime(0.0f)
+    { }
+    
+    FixedTimestep& setStep(float step);
+    FixedTimestep& setMaxSubsteps(int maxSubsteps);
+    
+    /// Add frame time and return the number of physics steps to take.
+    int advance(float frameTime);
+    
+    /// Fraction of a step between the last physics state and the frame time.
+    float alpha() const;
+    
+    void reset();
+};
+    
+}	// namespace YAMPE
+
+#endif
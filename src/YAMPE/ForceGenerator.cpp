@@ -0,0 +1,139 @@
+/**
+ @file 		ForceGenerator.cpp
+ @practical
+ @brief		Force generators applied to a whole ParticleStore at a time.
+ */
+
+#include <chrono>
+#include "ForceGenerator.h"
+#include "Profiler.h"
+
+using namespace YAMPE;
+
+//--------------------------------------------------------------
+// GravityForceGenerator
+//--------------------------------------------------------------
+
+void GravityForceGenerator::apply(ParticleStore& p, size_t begin, size_t end, float /*t*/) {
+    for (size_t i=begin; i<end; ++i) {
+        // particles of infinite mass are unaffected
+        float mass = p.inverseMass[i] > 0.0f ? 1.0f/p.inverseMass[i] : 0.0f;
+        p.fx[i] += mass*gravity.x;
+        p.fy[i] += mass*gravity.y;
+        p.fz[i] += mass*gravity.z;
+    }
+}
+
+const String GravityForceGenerator::toString() const {
+    std::ostringstream outs;
+    outs <<"Gravity = " <<gravity;
+    return outs.str();
+}
+
+//--------------------------------------------------------------
+// DragForceGenerator
+//--------------------------------------------------------------
+
+void DragForceGenerator::apply(ParticleStore& p, size_t begin, size_t end, float /*t*/) {
+    for (size_t i=begin; i<end; ++i) {
+        float ux = p.vx[i] - wind.x;
+        float uy = p.vy[i] - wind.y;
+        float uz = p.vz[i] - wind.z;
+        float k = k1 + k2*sqrt(ux*ux + uy*uy + uz*uz);
+        p.fx[i] -= k*ux;
+        p.fy[i] -= k*uy;
+        p.fz[i] -= k*uz;
+    }
+}
+
+const String DragForceGenerator::toString() const {
+    std::ostringstream outs;
+    outs <<"k1 = " <<k1 <<"    k2 = " <<k2 <<"    Wind = " <<wind;
+    return outs.str();
+}
+
+//--------------------------------------------------------------
+// AnchoredSpringForceGenerator
+//--------------------------------------------------------------
+
+void AnchoredSpringForceGenerator::apply(ParticleStore& p, size_t begin, size_t end, float /*t*/) {
+    for (size_t i=begin; i<end; ++i) {
+        float dx = p.px[i] - anchor.x;
+        float dy = p.py[i] - anchor.y;
+        float dz = p.pz[i] - anchor.z;
+        float length = sqrt(dx*dx + dy*dy + dz*dz);
+        // no direction when the particle sits on the anchor
+        float k = length > 0.0f ? -stiffness*(length - restLength)/length : 0.0f;
+        p.fx[i] += k*dx;
+        p.fy[i] += k*dy;
+        p.fz[i] += k*dz;
+    }
+}
+
+const String AnchoredSpringForceGenerator::toString() const {
+    std::ostringstream outs;
+    outs <<"Anchor = " <<anchor <<"    Stiffness = " <<stiffness <<"    Rest length = " <<restLength;
+    return outs.str();
+}
+
+//--------------------------------------------------------------
+// ForceRegistry
+//--------------------------------------------------------------
+
+ForceGenerator::Ref ForceRegistry::add(ForceGenerator::Ref generator) {
+    Entry entry = {generator, 0.0f, 0.0, 0, ofPtr<std::atomic<uint64_t> >(new std::atomic<uint64_t>(0))};
+    m_entries.push_back(entry);
+    return generator;
+}
+
+void ForceRegistry::remove(ForceGenerator::Ref generator) {
+    for (size_t i=0; i<m_entries.size(); ++i) {
+        if (m_entries[i].generator == generator) {
+            m_entries.erase(m_entries.begin() + i);
+            return;
+        }
+    }
+}
+
+void ForceRegistry::clear() {
+    m_entries.clear();
+}
+
+void ForceRegistry::apply(ParticleStore& particles, size_t begin, size_t end, float t) {
+    YAMPE_PROFILE_SCOPE("physics/forces");
+    typedef std::chrono::high_resolution_clock Clock;
+    for (size_t i=0; i<m_entries.size(); ++i) {
+        Entry& entry = m_entries[i];
+        if (!entry.generator->enabled) continue;
+        Clock::time_point start = Clock::now();
+        entry.generator->apply(particles, begin, end, t);
+        // ranges of one step may be applied in parallel (see Integrator::advance)
+        uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        entry.stepNanoseconds->fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+void ForceRegistry::beginStep() {
+    for (size_t i=0; i<m_entries.size(); ++i) {
+        m_entries[i].stepNanoseconds->store(0, std::memory_order_relaxed);
+    }
+}
+
+void ForceRegistry::endStep() {
+    for (size_t i=0; i<m_entries.size(); ++i) {
+        Entry& entry = m_entries[i];
+        double seconds = 1e-9 * entry.stepNanoseconds->load(std::memory_order_relaxed);
+        entry.lastSeconds = seconds;
+        entry.totalSeconds += seconds;
+        entry.steps++;
+    }
+}
+
+void ForceRegistry::resetTimings() {
+    for (size_t i=0; i<m_entries.size(); ++i) {
+        m_entries[i].lastSeconds = 0.0f;
+        m_entries[i].totalSeconds = 0.0;
+        m_entries[i].steps = 0;
+        m_entries[i].stepNanoseconds->store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,133 @@
+/**
+ @file 		ForceGenerator.h
+ @practical
+ @brief		Force generators applied to a whole ParticleStore at a time.
+ */
+
+#ifndef FORCE_GENERATOR_H
+#define FORCE_GENERATOR_H
+
+#include <atomic>
+#include <stdint.h>
+#include "ofMain.h"
+#include "Printable.h"
+#include "ParticleStore.h"
+
+namespace YAMPE {
+
+/**
+ A force generator adds a force to every particle in a range of a
+ ParticleStore (accumulated into fx, fy, fz and consumed by integrate).
+ 
+ Generators work on a whole range per call, so the virtual dispatch is
+ once per generator per step rather than once per particle.
+ */
+class ForceGenerator : public Printable {
+    
+public:
+    typedef ofPtr<ForceGenerator> Ref;
+    
+    bool enabled;
+    
+    ForceGenerator(String label) : Printable(label), enabled(true) { }
+    virtual ~ForceGenerator() { }
+    
+    /// Accumulate the force on particles [begin, end) at time t.
+    virtual void apply(ParticleStore& particles, size_t begin, size_t end, float t) = 0;
+};
+
+/**
+ Uniform gravitational field: force m*g on every particle of finite mass.
+ */
+class GravityForceGenerator : public ForceGenerator {
+    
+public:
+    ofVec3f gravity;        ///< acceleration due to gravity
+    
+    GravityForceGenerator(const ofVec3f& gravity) : ForceGenerator("Gravity"), gravity(gravity) { }
+    
+    virtual void apply(ParticleStore& particles, size_t begin, size_t end, float t);
+    virtual const String toString() const;
+};
+
+/**
+ Air resistance: force -(k1 + k2*|u|)*u where u is the velocity of the
+ particle relative to the air. A non-zero wind (velocity of the air) turns
+ it into a wind force as well.
+ */
+class DragForceGenerator : public ForceGenerator {
+    
+public:
+    float k1;               ///< linear drag coefficient
+    float k2;               ///< quadratic drag coefficient
+    ofVec3f wind;           ///< velocity of the air
+    
+    DragForceGenerator(float k1, float k2, const ofVec3f& wind = ofVec3f::zero()) :
+        ForceGenerator("Drag"), k1(k1), k2(k2), wind(wind) { }
+    
+    virtual void apply(ParticleStore& particles, size_t begin, size_t end, float t);
+    virtual const String toString() const;
+};
+
+/**
+ Spring tether of every particle to a fixed anchor point (Hooke's law).
+ */
+class AnchoredSpringForceGenerator : public ForceGenerator {
+    
+public:
+    ofVec3f anchor;
+    float stiffness;
+    float restLength;
+    
+    AnchoredSpringForceGenerator(const ofVec3f& anchor, float stiffness, float restLength) :
+        ForceGenerator("Spring"), anchor(anchor), stiffness(stiffness), restLength(restLength) { }
+    
+    virtual void apply(ParticleStore& particles, size_t begin, size_t end, float t);
+    virtual const String toString() const;
+};
+
+/**
+ A force registry holds the force generators acting on a particle store
+ and applies each enabled one to the whole range in turn, timing each so
+ that the cost of every force can be reported.
+ 
+ Disjoint ranges may be applied from several threads at once, and the
+ higher order integrators apply the forces several times per step, so the
+ time of each generator is added up over every range and stage between
+ beginStep() and endStep() (Integrator::advance calls both). Each thread
+ adds its time to an atomic total, so applying takes no lock.
+ */
+class ForceRegistry {
+    
+public:
+    struct Entry {
+        ForceGenerator::Ref generator;
+        float lastSeconds;          ///< time taken by the last step, over all ranges and stages
+        double totalSeconds;        ///< time taken by the steps since registered (or resetTimings)
+        unsigned long steps;        ///< steps timed
+        ofPtr<std::atomic<uint64_t> > stepNanoseconds;  ///< time taken so far in the step under way
+    };
+    
+    ForceGenerator::Ref add(ForceGenerator::Ref generator);
+    void remove(ForceGenerator::Ref generator);
+    void clear();
+    
+    size_t size() const { return m_entries.size(); }
+    const Entry& operator[](size_t i) const { return m_entries[i]; }
+    
+    /// Apply every enabled generator to particles [begin, end).
+    void apply(ParticleStore& particles, size_t begin, size_t end, float t);
+    
+    /// Start timing a step (before any range of it is applied).
+    void beginStep();
+    /// Finish timing a step (after every range of it has been applied).
+    void endStep();
+    void resetTimings();
+    
+private:
+    std::vector<Entry> m_entries;
+};
+    
+}	// namespace YAMPE
+
+#endif
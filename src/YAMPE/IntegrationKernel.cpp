@@ -0,0 +1,200 @@
+/**
+ @file 		IntegrationKernel.cpp
+ @practical
+ @brief		Vectorised integration kernels for a ParticleStore.
+ */
+
+#include "IntegrationKernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define YAMPE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+using namespace YAMPE;
+
+namespace {
+
+/**
+ Memoised pow(damping, dt); almost every particle in a batch shares the
+ same damping so the pow is evaluated once per run of equal values.
+ */
+struct DragCache {
+    float dt;
+    float damping;
+    float drag;
+    
+    DragCache(float dt) : dt(dt), damping(1.0f), drag(pow(1.0f, dt)) { }
+    
+    inline float operator()(float d) {
+        if (d != damping) {
+            damping = d;
+            drag = pow(d, dt);
+        }
+        return drag;
+    }
+};
+
+void integrateScalar(ParticleStore& s, float dt, size_t begin, size_t end) {
+    DragCache dragOf(dt);
+    for (size_t i=begin; i<end; ++i) {
+        
+        // An unmovable particle has zero inverseMass.
+        if (s.inverseMass[i] <= 0.0f) continue;
+        
+        // Update linear velocity from the resulting acceleration.
+        s.vx[i] += dt*(s.ax[i] + s.inverseMass[i]*s.fx[i]);
+        s.vy[i] += dt*(s.ay[i] + s.inverseMass[i]*s.fy[i]);
+        s.vz[i] += dt*(s.az[i] + s.inverseMass[i]*s.fz[i]);
+        
+        // Impose artificial drag.
+        float drag = dragOf(s.damping[i]);
+        s.vx[i] *= drag;
+        s.vy[i] *= drag;
+        s.vz[i] *= drag;
+        
+        // Update linear position.
+        s.px[i] += dt*s.vx[i];
+        s.py[i] += dt*s.vy[i];
+        s.pz[i] += dt*s.vz[i];
+        
+        // Clear the forces.
+        s.fx[i] = s.fy[i] = s.fz[i] = 0.0f;
+    }
+}
+
+#ifdef YAMPE_X86_SIMD
+
+// Multiplies and adds are kept separate (no FMA) so that the vector kernels
+// round exactly as the scalar kernel does.
+
+/// v' = (v + dt*(a + im*f))*drag, p' = p + dt*v', f' = 0 --- for lanes with im > 0 only.
+#define YAMPE_SSE_COMPONENT(v, p, a, f)                                         \
+    {                                                                           \
+        __m128 vOld = _mm_loadu_ps(&s.v[i]);                                    \
+        __m128 pOld = _mm_loadu_ps(&s.p[i]);                                    \
+        __m128 fOld = _mm_loadu_ps(&s.f[i]);                                    \
+        __m128 acc = _mm_add_ps(_mm_loadu_ps(&s.a[i]), _mm_mul_ps(im, fOld));   \
+        __m128 vNew = _mm_mul_ps(_mm_add_ps(vOld, _mm_mul_ps(vdt, acc)), drag); \
+        __m128 pNew = _mm_add_ps(pOld, _mm_mul_ps(vdt, vNew));                  \
+        _mm_storeu_ps(&s.v[i], _mm_or_ps(_mm_and_ps(mask, vNew), _mm_andnot_ps(mask, vOld))); \
+        _mm_storeu_ps(&s.p[i], _mm_or_ps(_mm_and_ps(mask, pNew), _mm_andnot_ps(mask, pOld))); \
+        _mm_storeu_ps(&s.f[i], _mm_andnot_ps(mask, fOld));                      \
+    }
+
+void integrateSSE(ParticleStore& s, float dt, size_t begin, size_t end) {
+    DragCache dragOf(dt);
+    const __m128 vdt = _mm_set1_ps(dt);
+    const __m128 zero = _mm_setzero_ps();
+    size_t i = begin;
+    for (; i+4<=end; i+=4) {
+        __m128 im = _mm_loadu_ps(&s.inverseMass[i]);
+        __m128 mask = _mm_cmpgt_ps(im, zero);
+        __m128 drag = _mm_setr_ps(dragOf(s.damping[i]), dragOf(s.damping[i+1]),
+                                  dragOf(s.damping[i+2]), dragOf(s.damping[i+3]));
+        YAMPE_SSE_COMPONENT(vx, px, ax, fx)
+        YAMPE_SSE_COMPONENT(vy, py, ay, fy)
+        YAMPE_SSE_COMPONENT(vz, pz, az, fz)
+    }
+    integrateScalar(s, dt, i, end);
+}
+
+#undef YAMPE_SSE_COMPONENT
+
+#define YAMPE_AVX_COMPONENT(v, p, a, f)                                                 \
+    {                                                                                   \
+        __m256 vOld = _mm256_loadu_ps(&s.v[i]);                                         \
+        __m256 pOld = _mm256_loadu_ps(&s.p[i]);                                         \
+        __m256 fOld = _mm256_loadu_ps(&s.f[i]);                                         \
+        __m256 acc = _mm256_add_ps(_mm256_loadu_ps(&s.a[i]), _mm256_mul_ps(im, fOld));  \
+        __m256 vNew = _mm256_mul_ps(_mm256_add_ps(vOld, _mm256_mul_ps(vdt, acc)), drag);\
+        __m256 pNew = _mm256_add_ps(pOld, _mm256_mul_ps(vdt, vNew));                    \
+        _mm256_storeu_ps(&s.v[i], _mm256_blendv_ps(vOld, vNew, mask));                  \
+        _mm256_storeu_ps(&s.p[i], _mm256_blendv_ps(pOld, pNew, mask));                  \
+        _mm256_storeu_ps(&s.f[i], _mm256_andnot_ps(mask, fOld));                        \
+    }
+
+__attribute__((target("avx2")))
+void integrateAVX2(ParticleStore& s, float dt, size_t begin, size_t end) {
+    DragCache dragOf(dt);
+    const __m256 vdt = _mm256_set1_ps(dt);
+    const __m256 zero = _mm256_setzero_ps();
+    size_t i = begin;
+    for (; i+8<=end; i+=8) {
+        __m256 im = _mm256_loadu_ps(&s.inverseMass[i]);
+        __m256 mask = _mm256_cmp_ps(im, zero, _CMP_GT_OQ);
+        __m256 drag = _mm256_setr_ps(dragOf(s.damping[i]), dragOf(s.damping[i+1]),
+                                     dragOf(s.damping[i+2]), dragOf(s.damping[i+3]),
+                                     dragOf(s.damping[i+4]), dragOf(s.damping[i+5]),
+                                     dragOf(s.damping[i+6]), dragOf(s.damping[i+7]));
+        YAMPE_AVX_COMPONENT(vx, px, ax, fx)
+        YAMPE_AVX_COMPONENT(vy, py, ay, fy)
+        YAMPE_AVX_COMPONENT(vz, pz, az, fz)
+    }
+    integrateSSE(s, dt, i, end);
+}
+
+#undef YAMPE_AVX_COMPONENT
+
+#endif  // YAMPE_X86_SIMD
+
+IntegrationKernel::Type& activeType() {
+    static IntegrationKernel::Type type = IntegrationKernel::best();
+    return type;
+}
+
+}   // namespace
+
+
+IntegrationKernel::Type IntegrationKernel::best() {
+    if (isSupported(AVX2)) return AVX2;
+    if (isSupported(SSE)) return SSE;
+    return SCALAR;
+}
+
+IntegrationKernel::Type IntegrationKernel::active() {
+    return activeType();
+}
+
+void IntegrationKernel::setActive(Type type) {
+    assert(isSupported(type) && "Expected an integration kernel supported by this CPU");
+    activeType() = type;
+}
+
+bool IntegrationKernel::isSupported(Type type) {
+    switch (type) {
+        case SCALAR: return true;
+#ifdef YAMPE_X86_SIMD
+        case SSE:    return __builtin_cpu_supports("sse2");
+        case AVX2:   return __builtin_cpu_supports("avx2");
+#endif
+        default:     return false;
+    }
+}
+
+const char* IntegrationKernel::name(Type type) {
+    switch (type) {
+        case SSE:    return "SSE";
+        case AVX2:   return "AVX2";
+        default:     return "Scalar";
+    }
+}
+
+void IntegrationKernel::integrate(ParticleStore& store, float dt, size_t begin, size_t end) {
+    integrate(activeType(), store, dt, begin, end);
+}
+
+void IntegrationKernel::integrate(Type type, ParticleStore& store, float dt, size_t begin, size_t end) {
+    
+    // Verify a non-zero time step.
+    assert(dt > 0.0f && "Expected a non-zero time step in IntegrationKernel::integrate");
+    assert(end <= store.size() && "Expected integration range within the store");
+    
+    switch (type) {
+#ifdef YAMPE_X86_SIMD
+        case AVX2: integrateAVX2(store, dt, begin, end); break;
+        case SSE:  integrateSSE(store, dt, begin, end); break;
+#endif
+        default:   integrateScalar(store, dt, begin, end); break;
+    }
+}
@@ -0,0 +1,44 @@
+/**
+ @file 		IntegrationKernel.h
+ @practical
+ @brief		Vectorised integration kernels for a ParticleStore.
+ */
+
+#ifndef INTEGRATION_KERNEL_H
+#define INTEGRATION_KERNEL_H
+
+#include "ParticleStore.h"
+
+namespace YAMPE {
+
+/**
+ Integration kernels apply the Particle::integrate update to a range of a
+ ParticleStore, 1 (scalar), 4 (SSE) or 8 (AVX2) particles at a time.
+ 
+ The widest kernel supported by the CPU is selected at run time. All kernels
+ give the same results as Particle::integrate: immovable particles
+ (inverse mass <= 0) are left untouched by masking the update rather than
+ branching, and the damping factor pow(damping, dt) is only evaluated when
+ the damping value changes from one particle to the next.
+ */
+class IntegrationKernel {
+
+public:
+    enum Type {SCALAR, SSE, AVX2};
+    
+    /// Widest kernel supported by this CPU.
+    static Type best();
+    /// Kernel currently used by ParticleStore::integrate.
+    static Type active();
+    /// Override the kernel used by ParticleStore::integrate (must be supported).
+    static void setActive(Type type);
+    static bool isSupported(Type type);
+    static const char* name(Type type);
+    
+    static void integrate(ParticleStore& store, float dt, size_t begin, size_t end);
+    static void integrate(Type type, ParticleStore& store, float dt, size_t begin, size_t end);
+};
+    
+}	// namespace YAMPE
+
+#endif
@@ -0,0 +1,341 @@
+/**
+ @file 		Integrator.cpp
+ @practical
+ @brief		Selectable integration schemes for a ParticleStore.
+ */
+
+#include "Integrator.h"
+#include "TaskScheduler.h"
+
+using namespace YAMPE;
+
+namespace {
+
+void resize(std::vector<float>* arrays, int count, size_t size) {
+    for (int c=0; c<count; ++c) {
+        if (arrays[c].size() < size) arrays[c].resize(size);
+    }
+}
+
+void copyRange(const std::vector<float>& from, std::vector<float>& to, size_t begin, size_t end) {
+    std::copy(from.begin() + begin, from.begin() + end, to.begin() + begin);
+}
+
+/**
+ Set the stage state to y0 + h*sum_j coefficients[j]*k[j] for the movable
+ particles, where k[j] holds the position (0-2) and velocity (3-5)
+ derivatives of stage j.
+ */
+void buildStage(const ParticleStore& y0, ParticleStore& stage, float h,
+                const double* coefficients, int stages, std::vector<float> (*k)[6],
+                size_t begin, size_t end) {
+    const std::vector<float>* p0[3] = {&y0.px, &y0.py, &y0.pz};
+    const std::vector<float>* v0[3] = {&y0.vx, &y0.vy, &y0.vz};
+    std::vector<float>* p[3] = {&stage.px, &stage.py, &stage.pz};
+    std::vector<float>* v[3] = {&stage.vx, &stage.vy, &stage.vz};
+    for (int c=0; c<3; ++c) {
+        for (size_t i=begin; i<end; ++i) {
+            if (y0.inverseMass[i] <= 0.0f) continue;
+            float dp = 0.0f, dv = 0.0f;
+            for (int j=0; j<stages; ++j) {
+                dp += float(coefficients[j])*k[j][c][i];
+                dv += float(coefficients[j])*k[j][3+c][i];
+            }
+            (*p[c])[i] = (*p0[c])[i] + h*dp;
+            (*v[c])[i] = (*v0[c])[i] + h*dv;
+        }
+    }
+}
+
+}   // namespace
+
+//--------------------------------------------------------------
+// Integrator
+//--------------------------------------------------------------
+
+Integrator::Ref Integrator::create(Type type) {
+    switch (type) {
+        case VERLET: return Ref(new VerletIntegrator());
+        case RK4:    return Ref(new RK4Integrator());
+        case RK45:   return Ref(new DormandPrinceIntegrator());
+        default:     return Ref(new EulerIntegrator());
+    }
+}
+
+const char* Integrator::name(Type type) {
+    switch (type) {
+        case VERLET: return "Velocity Verlet";
+        case RK4:    return "RK4";
+        case RK45:   return "Dormand-Prince RK45";
+        default:     return "Euler";
+    }
+}
+
+const String Integrator::toString() const {
+    return label();
+}
+
+void Integrator::advance(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                         size_t begin, size_t end, TaskScheduler* scheduler, size_t grain) {
+    forces.beginStep();
+    if (!scheduler || !isSeparable()) {
+        step(particles, forces, t, dt, begin, end);
+    } else {
+        // size the scratch state once, before the chunks share it
+        prepare(particles);
+        scheduler->parallelFor(begin, end, grain, [&](size_t b, size_t e) {
+            step(particles, forces, t, dt, b, e);
+        });
+    }
+    forces.endStep();
+}
+
+void Integrator::prepare(const ParticleStore& particles) {
+    if (m_stage.size() != particles.size()) m_stage = particles;
+}
+
+void Integrator::beginStage(const ParticleStore& particles, size_t begin, size_t end) {
+    ParticleStore& s = m_stage;
+    copyRange(particles.px, s.px, begin, end);
+    copyRange(particles.py, s.py, begin, end);
+    copyRange(particles.pz, s.pz, begin, end);
+    copyRange(particles.vx, s.vx, begin, end);
+    copyRange(particles.vy, s.vy, begin, end);
+    copyRange(particles.vz, s.vz, begin, end);
+    copyRange(particles.ax, s.ax, begin, end);
+    copyRange(particles.ay, s.ay, begin, end);
+    copyRange(particles.az, s.az, begin, end);
+    copyRange(particles.inverseMass, s.inverseMass, begin, end);
+    copyRange(particles.damping, s.damping, begin, end);
+    copyRange(particles.radius, s.radius, begin, end);
+}
+
+void Integrator::evaluate(ParticleStore& stage, const ParticleStore& particles, ForceRegistry& forces, float t,
+                          size_t begin, size_t end, std::vector<float>* a) {
+    // forces applied directly to the particles are held constant over the step
+    copyRange(particles.fx, stage.fx, begin, end);
+    copyRange(particles.fy, stage.fy, begin, end);
+    copyRange(particles.fz, stage.fz, begin, end);
+    forces.apply(stage, begin, end, t);
+    
+    for (size_t i=begin; i<end; ++i) {
+        a[0][i] = stage.ax[i] + stage.inverseMass[i]*stage.fx[i];
+        a[1][i] = stage.ay[i] + stage.inverseMass[i]*stage.fy[i];
+        a[2][i] = stage.az[i] + stage.inverseMass[i]*stage.fz[i];
+    }
+}
+
+void Integrator::finish(ParticleStore& particles, float dt, size_t begin, size_t end) {
+    float damping = 1.0f, drag = 1.0f;
+    for (size_t i=begin; i<end; ++i) {
+        if (particles.inverseMass[i] <= 0.0f) continue;
+        
+        // Impose artificial drag.
+        if (particles.damping[i] != damping) {
+            damping = particles.damping[i];
+            drag = pow(damping, dt);
+        }
+        particles.vx[i] *= drag;
+        particles.vy[i] *= drag;
+        particles.vz[i] *= drag;
+        
+        // Clear the forces.
+        particles.fx[i] = particles.fy[i] = particles.fz[i] = 0.0f;
+    }
+}
+
+//--------------------------------------------------------------
+// EulerIntegrator
+//--------------------------------------------------------------
+
+void EulerIntegrator::step(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                           size_t begin, size_t end) {
+    forces.apply(particles, begin, end, t);
+    particles.integrate(dt, begin, end);
+}
+
+//--------------------------------------------------------------
+// VerletIntegrator
+//--------------------------------------------------------------
+
+void VerletIntegrator::prepare(const ParticleStore& particles) {
+    Integrator::prepare(particles);
+    resize(m_a0, 3, particles.size());
+    resize(m_a1, 3, particles.size());
+}
+
+void VerletIntegrator::step(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                            size_t begin, size_t end) {
+    ParticleStore& s = particles;
+    
+    prepare(particles);
+    beginStage(particles, begin, end);
+    evaluate(m_stage, particles, forces, t, begin, end, m_a0);
+    
+    // new position, and a first order velocity for velocity dependent forces
+    for (size_t i=begin; i<end; ++i) {
+        if (s.inverseMass[i] <= 0.0f) continue;
+        m_stage.px[i] = s.px[i] + dt*s.vx[i] + 0.5f*dt*dt*m_a0[0][i];
+        m_stage.py[i] = s.py[i] + dt*s.vy[i] + 0.5f*dt*dt*m_a0[1][i];
+        m_stage.pz[i] = s.pz[i] + dt*s.vz[i] + 0.5f*dt*dt*m_a0[2][i];
+        m_stage.vx[i] = s.vx[i] + dt*m_a0[0][i];
+        m_stage.vy[i] = s.vy[i] + dt*m_a0[1][i];
+        m_stage.vz[i] = s.vz[i] + dt*m_a0[2][i];
+    }
+    evaluate(m_stage, particles, forces, t + dt, begin, end, m_a1);
+    
+    for (size_t i=begin; i<end; ++i) {
+        if (s.inverseMass[i] <= 0.0f) continue;
+        s.px[i] = m_stage.px[i];
+        s.py[i] = m_stage.py[i];
+        s.pz[i] = m_stage.pz[i];
+        s.vx[i] += 0.5f*dt*(m_a0[0][i] + m_a1[0][i]);
+        s.vy[i] += 0.5f*dt*(m_a0[1][i] + m_a1[1][i]);
+        s.vz[i] += 0.5f*dt*(m_a0[2][i] + m_a1[2][i]);
+    }
+    finish(particles, dt, begin, end);
+}
+
+//--------------------------------------------------------------
+// RK4Integrator
+//--------------------------------------------------------------
+
+void RK4Integrator::prepare(const ParticleStore& particles) {
+    Integrator::prepare(particles);
+    for (int s=0; s<4; ++s) resize(m_k[s], 6, particles.size());
+}
+
+void RK4Integrator::step(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                         size_t begin, size_t end) {
+    static const double c[4] = {0.0, 0.5, 0.5, 1.0};
+    
+    prepare(particles);
+    beginStage(particles, begin, end);
+    for (int s=0; s<4; ++s) {
+        if (s > 0) {
+            // stage s is a step of c[s]*dt along the derivative of stage s-1
+            double coefficients[4] = {0.0, 0.0, 0.0, 0.0};
+            coefficients[s-1] = c[s];
+            buildStage(particles, m_stage, dt, coefficients, s, m_k, begin, end);
+        }
+        std::copy(m_stage.vx.begin() + begin, m_stage.vx.begin() + end, m_k[s][0].begin() + begin);
+        std::copy(m_stage.vy.begin() + begin, m_stage.vy.begin() + end, m_k[s][1].begin() + begin);
+        std::copy(m_stage.vz.begin() + begin, m_stage.vz.begin() + end, m_k[s][2].begin() + begin);
+        evaluate(m_stage, particles, forces, t + float(c[s])*dt, begin, end, &m_k[s][3]);
+    }
+    
+    static const double b[4] = {1.0/6.0, 1.0/3.0, 1.0/3.0, 1.0/6.0};
+    buildStage(particles, m_stage, dt, b, 4, m_k, begin, end);
+    std::copy(m_stage.px.begin() + begin, m_stage.px.begin() + end, particles.px.begin() + begin);
+    std::copy(m_stage.py.begin() + begin, m_stage.py.begin() + end, particles.py.begin() + begin);
+    std::copy(m_stage.pz.begin() + begin, m_stage.pz.begin() + end, particles.pz.begin() + begin);
+    std::copy(m_stage.vx.begin() + begin, m_stage.vx.begin() + end, particles.vx.begin() + begin);
+    std::copy(m_stage.vy.begin() + begin, m_stage.vy.begin() + end, particles.vy.begin() + begin);
+    std::copy(m_stage.vz.begin() + begin, m_stage.vz.begin() + end, particles.vz.begin() + begin);
+    finish(particles, dt, begin, end);
+}
+
+//--------------------------------------------------------------
+// DormandPrinceIntegrator
+//--------------------------------------------------------------
+
+namespace {
+
+// Dormand-Prince 5(4) Butcher tableau.
+const double DP_C[7] = {0.0, 1.0/5.0, 3.0/10.0, 4.0/5.0, 8.0/9.0, 1.0, 1.0};
+const double DP_A[7][6] = {
+    {0.0},
+    {1.0/5.0},
+    {3.0/40.0, 9.0/40.0},
+    {44.0/45.0, -56.0/15.0, 32.0/9.0},
+    {19372.0/6561.0, -25360.0/2187.0, 64448.0/6561.0, -212.0/729.0},
+    {9017.0/3168.0, -355.0/33.0, 46732.0/5247.0, 49.0/176.0, -5103.0/18656.0},
+    {35.0/384.0, 0.0, 500.0/1113.0, 125.0/192.0, -2187.0/6784.0, 11.0/84.0}
+};
+// Fifth order weights minus fourth order weights (the error estimate).
+const double DP_E[7] = {
+    35.0/384.0 - 5179.0/57600.0,
+    0.0,
+    500.0/1113.0 - 7571.0/16695.0,
+    125.0/192.0 - 393.0/640.0,
+    -2187.0/6784.0 + 92097.0/339200.0,
+    11.0/84.0 - 187.0/2100.0,
+    -1.0/40.0
+};
+
+}   // namespace
+
+void DormandPrinceIntegrator::prepare(const ParticleStore& particles) {
+    Integrator::prepare(particles);
+    for (int s=0; s<7; ++s) resize(m_k[s], 6, particles.size());
+}
+
+float DormandPrinceIntegrator::attempt(const ParticleStore& particles, ForceRegistry& forces, float t, float h,
+                                       size_t begin, size_t end) {
+    for (int s=0; s<7; ++s) {
+        if (s > 0) buildStage(particles, m_stage, h, DP_A[s], s, m_k, begin, end);
+        std::copy(m_stage.vx.begin() + begin, m_stage.vx.begin() + end, m_k[s][0].begin() + begin);
+        std::copy(m_stage.vy.begin() + begin, m_stage.vy.begin() + end, m_k[s][1].begin() + begin);
+        std::copy(m_stage.vz.begin() + begin, m_stage.vz.begin() + end, m_k[s][2].begin() + begin);
+        evaluate(m_stage, particles, forces, t + float(DP_C[s])*h, begin, end, &m_k[s][3]);
+    }
+    // the last stage is evaluated at the fifth order solution, which stays in m_stage
+    
+    float error = 0.0f;
+    for (int c=0; c<6; ++c) {
+        for (size_t i=begin; i<end; ++i) {
+            if (particles.inverseMass[i] <= 0.0f) continue;
+            float e = 0.0f;
+            for (int j=0; j<7; ++j) e += float(DP_E[j])*m_k[j][c][i];
+            error = std::max(error, fabsf(h*e));
+        }
+    }
+    return error;
+}
+
+void DormandPrinceIntegrator::step(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                                   size_t begin, size_t end) {
+    
+    if (suggestedStep <= 0.0f) suggestedStep = dt;
+    prepare(particles);
+    
+    float remaining = dt;
+    while (remaining > 0.0f) {
+        float h = std::min(suggestedStep, remaining);
+        
+        beginStage(particles, begin, end);
+        float error = attempt(particles, forces, t, h, begin, end);
+        bool isAccepted = error <= tolerance || h <= minStep;
+        
+        if (isAccepted) {
+            for (size_t i=begin; i<end; ++i) {
+                if (particles.inverseMass[i] <= 0.0f) continue;
+                particles.px[i] = m_stage.px[i];
+                particles.py[i] = m_stage.py[i];
+                particles.pz[i] = m_stage.pz[i];
+                particles.vx[i] = m_stage.vx[i];
+                particles.vy[i] = m_stage.vy[i];
+                particles.vz[i] = m_stage.vz[i];
+            }
+            t += h;
+            remaining -= h;
+            substeps++;
+        } else {
+            rejections++;
+        }
+        
+        // Standard step size control; a substep shortened only to finish
+        // the step says nothing about how large the next one can be.
+        if (!isAccepted || h == suggestedStep) {
+            float factor = error > 0.0f ? 0.9f*pow(tolerance/error, 0.2f) : 5.0f;
+            suggestedStep = std::max(minStep, h*ofClamp(factor, 0.2f, 5.0f));
+        }
+    }
+    finish(particles, dt, begin, end);
+}
+
+const String DormandPrinceIntegrator::toString() const {
+    std::ostringstream outs;
+    outs <<"Tolerance = " <<tolerance <<"    Substeps = " <<substeps <<"    Rejections = " <<rejections;
+    return outs.str();
+}
@@ -0,0 +1,151 @@
+/**
+ @file 		Integrator.h
+ @practical
+ @brief		Selectable integration schemes for a ParticleStore.
+ */
+
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include "ofMain.h"
+#include "Printable.h"
+#include "ParticleStore.h"
+#include "ForceGenerator.h"
+
+namespace YAMPE {
+
+class TaskScheduler;
+
+/**
+ An integrator advances a range of a ParticleStore by one time step under
+ the forces of a ForceRegistry (plus any force already accumulated on the
+ particles, held constant over the step).
+ 
+ Higher order schemes evaluate the forces several times per step, on
+ scratch copies of the particles that are kept between steps so that
+ stepping does not allocate. As in Particle::integrate, particles of
+ infinite mass are not moved, damping is applied once per step, and the
+ accumulated forces are cleared.
+ */
+class Integrator : public Printable {
+    
+public:
+    typedef ofPtr<Integrator> Ref;
+    
+    enum Type {EULER, VERLET, RK4, RK45};
+    
+    static Ref create(Type type);
+    static const char* name(Type type);
+    
+    Integrator(String label) : Printable(label) { }
+    virtual ~Integrator() { }
+    
+    virtual void step(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                      size_t begin, size_t end) = 0;
+    
+    /**
+     * Step particles [begin, end), in chunks of grain particles on the
+     * scheduler if there is one and the scheme is separable. The result is
+     * the same as step() whatever the number of threads. The time of each
+     * force is totalled over the step (see ForceRegistry::beginStep).
+     */
+    void advance(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                 size_t begin, size_t end, TaskScheduler* scheduler, size_t grain = 4096);
+    
+    /// True if stepping disjoint ranges one by one is the same as stepping their union.
+    virtual bool isSeparable() const { return true; }
+    
+    /// Size the scratch state for the store (step does this too, but not safely in parallel).
+    virtual void prepare(const ParticleStore& particles);
+    
+    virtual const String toString() const;
+    
+protected:
+    ParticleStore m_stage;          ///< state at which forces are evaluated
+    
+    /// Copy particles [begin, end) (but not their applied forces) into the stage.
+    void beginStage(const ParticleStore& particles, size_t begin, size_t end);
+    /// Accelerations at the stage state: acceleration + inverseMass*(applied + registry forces).
+    void evaluate(ParticleStore& stage, const ParticleStore& particles, ForceRegistry& forces, float t,
+                  size_t begin, size_t end, std::vector<float>* a);
+    /// Damp velocities and clear forces at the end of a step.
+    void finish(ParticleStore& particles, float dt, size_t begin, size_t end);
+};
+
+/**
+ Semi-implicit Euler, exactly as Particle::integrate (first order).
+ */
+class EulerIntegrator : public Integrator {
+public:
+    EulerIntegrator() : Integrator("Euler") { }
+    virtual void step(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                      size_t begin, size_t end);
+    virtual void prepare(const ParticleStore& /*particles*/) { }
+};
+
+/**
+ Velocity Verlet (second order, symplectic for position dependent forces).
+ */
+class VerletIntegrator : public Integrator {
+public:
+    VerletIntegrator() : Integrator("Velocity Verlet") { }
+    virtual void step(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                      size_t begin, size_t end);
+    virtual void prepare(const ParticleStore& particles);
+private:
+    std::vector<float> m_a0[3], m_a1[3];
+};
+
+/**
+ Classic fourth order Runge-Kutta.
+ */
+class RK4Integrator : public Integrator {
+public:
+    RK4Integrator() : Integrator("RK4") { }
+    virtual void step(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                      size_t begin, size_t end);
+    virtual void prepare(const ParticleStore& particles);
+private:
+    std::vector<float> m_k[4][6];   ///< per stage: dx, dy, dz, dvx, dvy, dvz
+};
+
+/**
+ Adaptive Dormand-Prince RK4(5). Each step is covered by as many substeps
+ as needed to keep the estimated local error (largest over all particles,
+ in position and velocity) below tolerance; the substep size carries over
+ from one step to the next.
+ */
+class DormandPrinceIntegrator : public Integrator {
+public:
+    float tolerance;                ///< allowed local error per substep
+    float minStep;                  ///< smallest substep taken (s)
+    float suggestedStep;            ///< substep to try next (s)
+    unsigned long substeps;         ///< substeps accepted since construction
+    unsigned long rejections;       ///< substeps rejected since construction
+    
+    DormandPrinceIntegrator(float tolerance = 1e-4f) :
+        Integrator("Dormand-Prince RK45"),
+        tolerance(tolerance),
+        minStep(1e-5f),
+        suggestedStep(0.0f),
+        substeps(0),
+        rejections(0)
+    { }
+    
+    virtual void step(ParticleStore& particles, ForceRegistry& forces, float t, float dt,
+                      size_t begin, size_t end);
+    virtual void prepare(const ParticleStore& particles);
+    /// The substep size depends on every particle in the range, so ranges are not separable.
+    virtual bool isSeparable() const { return false; }
+    virtual const String toString() const;
+    
+private:
+    std::vector<float> m_k[7][6];   ///< per stage: dx, dy, dz, dvx, dvy, dvz
+    /// Attempt one substep of size h; returns the error estimate and leaves the 5th order result in m_stage.
+    float attempt(const ParticleStore& particles, ForceRegistry& forces, float t, float h,
+                  size_t begin, size_t end);
+};
+    
+}	// namespace YAMPE
+
+#endif
@@ -108,6 +108,10 @@ Particle& Particle::setWireColor(const ofColor wireColor) {
     return *this;
 }
 
+const ofColor& Particle::getBodyColor() const {
+    return bodyColor;
+}
+
 const String Particle::toString() const {
     std::ostringstream outs;
     outs<<"Position = " <<position <<"    "
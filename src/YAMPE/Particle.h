@@ -70,6 +70,7 @@ public:
     Particle& setRadius(float radius);
     Particle& setBodyColor(const ofColor bodyColor);
     Particle& setWireColor(const ofColor wireColor);
+    const ofColor& getBodyColor() const;
     
     virtual const String toString() const;
     
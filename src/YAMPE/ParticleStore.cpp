@@ -0,0 +1,200 @@
+/**
+ @file 		ParticleStore.cpp
+ @practical
+ @brief		Implemention of a structure-of-arrays particle container.
+ */
+
+#include "ParticleStore.h"
+#include "IntegrationKernel.h"
+#include "BinaryIO.h"
+
+using namespace YAMPE;
+
+//--------------------------------------------------------------
+// ParticleHandle
+//--------------------------------------------------------------
+
+ofVec3f ParticleHandle::position() const {
+    return ofVec3f(m_store->px[m_index], m_store->py[m_index], m_store->pz[m_index]);
+}
+
+ofVec3f ParticleHandle::velocity() const {
+    return ofVec3f(m_store->vx[m_index], m_store->vy[m_index], m_store->vz[m_index]);
+}
+
+ofVec3f ParticleHandle::acceleration() const {
+    return ofVec3f(m_store->ax[m_index], m_store->ay[m_index], m_store->az[m_index]);
+}
+
+float ParticleHandle::radius() const {
+    return m_store->radius[m_index];
+}
+
+ParticleHandle& ParticleHandle::setPosition(const ofVec3f& position) {
+    m_store->px[m_index] = position.x;
+    m_store->py[m_index] = position.y;
+    m_store->pz[m_index] = position.z;
+    return *this;
+}
+
+ParticleHandle& ParticleHandle::setVelocity(const ofVec3f& velocity) {
+    m_store->vx[m_index] = velocity.x;
+    m_store->vy[m_index] = velocity.y;
+    m_store->vz[m_index] = velocity.z;
+    return *this;
+}
+
+ParticleHandle& ParticleHandle::setAcceleration(const ofVec3f& acceleration) {
+    m_store->ax[m_index] = acceleration.x;
+    m_store->ay[m_index] = acceleration.y;
+    m_store->az[m_index] = acceleration.z;
+    return *this;
+}
+
+ParticleHandle& ParticleHandle::setRadius(float radius) {
+    m_store->radius[m_index] = radius;
+    return *this;
+}
+
+ParticleHandle& ParticleHandle::setMass(float mass) {
+    assert (mass != 0.0f && "Expected positive mass for particle.");
+    m_store->inverseMass[m_index] = 1.0f/mass;
+    return *this;
+}
+
+float ParticleHandle::mass() const {
+    return 1.0f/m_store->inverseMass[m_index];
+}
+
+ParticleHandle& ParticleHandle::setInverseMass(float inverseMass) {
+    m_store->inverseMass[m_index] = inverseMass;
+    return *this;
+}
+
+float ParticleHandle::inverseMass() const {
+    return m_store->inverseMass[m_index];
+}
+
+bool ParticleHandle::hasFiniteMass() const {
+    return m_store->inverseMass[m_index] > 0.0f;
+}
+
+ParticleHandle& ParticleHandle::setDamping(float damping) {
+    m_store->damping[m_index] = damping;
+    return *this;
+}
+
+float ParticleHandle::damping() const {
+    return m_store->damping[m_index];
+}
+
+void ParticleHandle::clearForce() {
+    m_store->fx[m_index] = m_store->fy[m_index] = m_store->fz[m_index] = 0.0f;
+}
+
+ParticleHandle& ParticleHandle::applyForce(const ofVec3f& force) {
+    m_store->fx[m_index] += force.x;
+    m_store->fy[m_index] += force.y;
+    m_store->fz[m_index] += force.z;
+    return *this;
+}
+
+void ParticleHandle::copyTo(Particle& particle) const {
+    particle.position = position();
+    particle.velocity = velocity();
+    particle.acceleration = acceleration();
+    particle.radius = radius();
+    particle.setInverseMass(inverseMass());
+    particle.setDamping(damping());
+}
+
+ParticleHandle& ParticleHandle::copyFrom(const Particle& particle) {
+    setPosition(particle.position);
+    setVelocity(particle.velocity);
+    setAcceleration(particle.acceleration);
+    setRadius(particle.radius);
+    setInverseMass(particle.inverseMass());
+    setDamping(particle.damping());
+    clearForce();
+    return *this;
+}
+
+//--------------------------------------------------------------
+// ParticleStore
+//--------------------------------------------------------------
+
+void ParticleStore::reserve(size_t capacity) {
+    px.reserve(capacity); py.reserve(capacity); pz.reserve(capacity);
+    vx.reserve(capacity); vy.reserve(capacity); vz.reserve(capacity);
+    ax.reserve(capacity); ay.reserve(capacity); az.reserve(capacity);
+    fx.reserve(capacity); fy.reserve(capacity); fz.reserve(capacity);
+    inverseMass.reserve(capacity);
+    damping.reserve(capacity);
+    radius.reserve(capacity);
+}
+
+void ParticleStore::clear() {
+    px.clear(); py.clear(); pz.clear();
+    vx.clear(); vy.clear(); vz.clear();
+    ax.clear(); ay.clear(); az.clear();
+    fx.clear(); fy.clear(); fz.clear();
+    inverseMass.clear();
+    damping.clear();
+    radius.clear();
+}
+
+ParticleHandle ParticleStore::add() {
+    px.push_back(0.0f); py.push_back(0.0f); pz.push_back(0.0f);
+    vx.push_back(0.0f); vy.push_back(0.0f); vz.push_back(0.0f);
+    ax.push_back(0.0f); ay.push_back(0.0f); az.push_back(0.0f);
+    fx.push_back(0.0f); fy.push_back(0.0f); fz.push_back(0.0f);
+    inverseMass.push_back(1.0f);
+    damping.push_back(1.0f);
+    radius.push_back(0.1f);
+    return ParticleHandle(this, size()-1);
+}
+
+ParticleHandle ParticleStore::add(const Particle& particle) {
+    return add().copyFrom(particle);
+}
+
+void ParticleStore::clearForces() {
+    std::fill(fx.begin(), fx.end(), 0.0f);
+    std::fill(fy.begin(), fy.end(), 0.0f);
+    std::fill(fz.begin(), fz.end(), 0.0f);
+}
+
+void ParticleStore::write(std::ostream& out) const {
+    writeValue(out, uint32_t(size()));
+    writeArray(out, px); writeArray(out, py); writeArray(out, pz);
+    writeArray(out, vx); writeArray(out, vy); writeArray(out, vz);
+    writeArray(out, ax); writeArray(out, ay); writeArray(out, az);
+    writeArray(out, fx); writeArray(out, fy); writeArray(out, fz);
+    writeArray(out, inverseMass);
+    writeArray(out, damping);
+    writeArray(out, radius);
+}
+
+bool ParticleStore::read(std::istream& in) {
+    uint32_t count;
+    if (!readValue(in, count) || count != size()) return false;
+    return readArray(in, px) && readArray(in, py) && readArray(in, pz)
+        && readArray(in, vx) && readArray(in, vy) && readArray(in, vz)
+        && readArray(in, ax) && readArray(in, ay) && readArray(in, az)
+        && readArray(in, fx) && readArray(in, fy) && readArray(in, fz)
+        && readArray(in, inverseMass)
+        && readArray(in, damping)
+        && readArray(in, radius);
+}
+
+void ParticleStore::integrate(float dt) {
+    integrate(dt, 0, size());
+}
+
+/**
+ Same update as Particle::integrate, using the widest integration kernel
+ available (see IntegrationKernel).
+ */
+void ParticleStore::integrate(float dt, size_t begin, size_t end) {
+    IntegrationKernel::integrate(*this, dt, begin, end);
+}
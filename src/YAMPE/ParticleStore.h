@@ -0,0 +1,120 @@
+/**
+ @file 		ParticleStore.h
+ @practical
+ @brief		Specification of a structure-of-arrays particle container.
+ */
+
+#ifndef PARTICLE_STORE_H
+#define PARTICLE_STORE_H
+
+#include "ofMain.h"
+#include "Particle.h"
+
+namespace YAMPE {
+
+class ParticleStore;
+
+/**
+ A particle handle is a lightweight view (store + index) onto a single
+ particle held in a ParticleStore.
+ 
+ Handles are cheap to copy and remain valid for as long as the store is
+ not cleared. Use copyTo() to transfer the simulated state back into a
+ full Particle when it is needed for drawing or logging.
+ */
+class ParticleHandle {
+    
+private:
+    ParticleStore* m_store;
+    size_t m_index;
+    
+public:
+    ParticleHandle() : m_store(NULL), m_index(0) { }
+    ParticleHandle(ParticleStore* store, size_t index) : m_store(store), m_index(index) { }
+    
+    bool isValid() const { return m_store!=NULL; }
+    size_t index() const { return m_index; }
+    ParticleStore* store() const { return m_store; }
+    
+    ofVec3f position() const;
+    ofVec3f velocity() const;
+    ofVec3f acceleration() const;
+    float radius() const;
+    
+    ParticleHandle& setPosition(const ofVec3f& position);
+    ParticleHandle& setVelocity(const ofVec3f& velocity);
+    ParticleHandle& setAcceleration(const ofVec3f& acceleration);
+    ParticleHandle& setRadius(float radius);
+    
+    ParticleHandle& setMass(float mass);
+    float mass() const;
+    
+    ParticleHandle& setInverseMass(float inverseMass);
+    float inverseMass() const;
+    
+    bool hasFiniteMass() const;
+    
+    ParticleHandle& setDamping(float damping);
+    float damping() const;
+    
+    void clearForce();
+    ParticleHandle& applyForce(const ofVec3f& force);
+    
+    /// Copy the simulated (hot) state into a full particle.
+    void copyTo(Particle& particle) const;
+    /// Copy the simulated (hot) state of a full particle into the store.
+    ParticleHandle& copyFrom(const Particle& particle);
+};
+
+/**
+ A particle store holds the simulated state of many particles as a
+ structure of arrays.
+ 
+ Only the state touched by integration (position, velocity, acceleration,
+ accumulated force, inverse mass, damping and radius) is kept here; colours,
+ labels and other display state stay with Particle. Each component lives in
+ its own contiguous array so that integrate() streams through memory
+ rather than chasing one heap object per particle.
+ */
+class ParticleStore {
+    
+public:
+    typedef ofPtr<ParticleStore> Ref;
+    
+    std::vector<float> px, py, pz;          ///< Positions.
+    std::vector<float> vx, vy, vz;          ///< Velocities.
+    std::vector<float> ax, ay, az;          ///< Accelerations (excluding forces).
+    std::vector<float> fx, fy, fz;          ///< (Sum of) forces applied to each particle.
+    std::vector<float> inverseMass;         ///< 1/mass of each particle.
+    std::vector<float> damping;             ///< Artificial damping of each particle.
+    std::vector<float> radius;              ///< Radius of each particle.
+    
+    size_t size() const { return px.size(); }
+    bool empty() const { return px.empty(); }
+    
+    void reserve(size_t capacity);
+    void clear();
+    
+    /// Append a particle at the origin with unit inverse mass and damping.
+    ParticleHandle add();
+    /// Append a particle copying the simulated state of the given particle.
+    ParticleHandle add(const Particle& particle);
+    
+    ParticleHandle operator[](size_t index) { return ParticleHandle(this, index); }
+    
+    void clearForces();
+    
+    /// Write the state of every particle (for snapshots).
+    void write(std::ostream& out) const;
+    /// Read the state written by write() from a store of the same size.
+    bool read(std::istream& in);
+    
+    /// Integrate every particle in the store forward by dt.
+    void integrate(float dt);
+    /// Integrate the particles in [begin, end) forward by dt.
+    void integrate(float dt, size_t begin, size_t end);
+};
+    
+}	// namespace YAMPE
+
+#endif
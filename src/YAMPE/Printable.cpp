@@ -9,7 +9,7 @@
 
 using namespace YAMPE;
 
-String Printable::label() const {
+const String& Printable::label() const {
 	return m_label;
 }
 Printable& Printable::setLabel(String label) {
@@ -21,7 +21,7 @@ public:
 	Printable(String label) : m_label(label) { };
     
 	Printable& setLabel(String label);
-	String label() const;
+	const String& label() const;
     
 	virtual const String toString() const = 0;
 	friend std::ostream& operator <<(std::ostream& outputStream, const Printable& p);
@@ -0,0 +1,155 @@
+/**
+ @file 		Profiler.cpp
+ @practical
+ @brief		Scoped timers with rolling statistics and Chrome trace capture.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include "Profiler.h"
+
+using namespace YAMPE;
+
+//--------------------------------------------------------------
+// ProfileSite
+//--------------------------------------------------------------
+
+ProfileSite::ProfileSite(const std::string& name) : name(name), m_count(0) {
+    for (int i=0; i<WINDOW; ++i) m_samples[i].store(0.0f, std::memory_order_relaxed);
+}
+
+void ProfileSite::record(float seconds) {
+    unsigned long n = m_count.fetch_add(1, std::memory_order_relaxed);
+    m_samples[n % WINDOW].store(seconds, std::memory_order_relaxed);
+}
+
+ProfileSite::Statistics ProfileSite::statistics() const {
+    Statistics statistics = {0.0f, 0.0f, 0.0f, 0.0f, 0};
+    unsigned long count = m_count.load(std::memory_order_relaxed);
+    statistics.count = count;
+    if (count == 0) return statistics;
+
+    // a copy of the window, sorted for the percentile (samples being written
+    // meanwhile may be old or new, either is fine)
+    int n = int(std::min<unsigned long>(count, WINDOW));
+    float samples[WINDOW];
+    double sum = 0.0;
+    for (int i=0; i<n; ++i) {
+        samples[i] = m_samples[i].load(std::memory_order_relaxed);
+        sum += samples[i];
+    }
+    statistics.last = m_samples[(count - 1) % WINDOW].load(std::memory_order_relaxed);
+    std::sort(samples, samples + n);
+    statistics.min = samples[0];
+    statistics.average = float(sum / n);
+    statistics.p99 = samples[std::min(n - 1, int(ceilf(0.99f * n)) - 1)];
+    return statistics;
+}
+
+//--------------------------------------------------------------
+// Profiler
+//--------------------------------------------------------------
+
+Profiler::Profiler() : isEnabled(true), m_isCapturing(false), m_dropped(0) { }
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+int64_t Profiler::now() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+ProfileSite* Profiler::site(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i=0; i<m_sites.size(); ++i) {
+        if (m_sites[i]->name == name) return m_sites[i].get();
+    }
+    m_sites.push_back(ofPtr<ProfileSite>(new ProfileSite(name)));
+    return m_sites.back().get();
+}
+
+std::vector<ProfileSite*> Profiler::sites() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<ProfileSite*> sites;
+    for (size_t i=0; i<m_sites.size(); ++i) sites.push_back(m_sites[i].get());
+    return sites;
+}
+
+/**
+ * Event buffer of the calling thread, registered on first use.
+ */
+Profiler::ThreadEvents& Profiler::threadEvents() {
+    static thread_local ThreadEvents* events = NULL;
+    if (!events) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_threads.push_back(ofPtr<ThreadEvents>(new ThreadEvents()));
+        events = m_threads.back().get();
+        events->id = int(m_threads.size());
+        std::ostringstream name;
+        name <<"thread " <<events->id;
+        events->name = name.str();
+    }
+    return *events;
+}
+
+void Profiler::nameThread(const std::string& name) {
+    ThreadEvents& events = threadEvents();
+    std::lock_guard<std::mutex> lock(events.mutex);
+    events.name = name;
+}
+
+void Profiler::startCapture() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i=0; i<m_threads.size(); ++i) {
+        std::lock_guard<std::mutex> threadLock(m_threads[i]->mutex);
+        m_threads[i]->events.clear();
+    }
+    m_dropped = 0;
+    m_isCapturing = true;
+}
+
+void Profiler::capture(const ProfileSite* site, int64_t begin, int64_t end) {
+    ThreadEvents& events = threadEvents();
+    std::lock_guard<std::mutex> lock(events.mutex);
+    if (events.events.size() >= MAX_EVENTS) {
+        m_dropped++;
+        return;
+    }
+    Event event = {site, begin, end};
+    events.events.push_back(event);
+}
+
+bool Profiler::stopCapture(const std::string& fileName) {
+    m_isCapturing = false;
+
+    std::ofstream out(fileName.c_str());
+    if (!out) return false;
+    out <<std::fixed <<std::setprecision(3);
+
+    // complete ("X") events in microseconds, and the name of each thread
+    out <<"{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool isFirst = true;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t t=0; t<m_threads.size(); ++t) {
+        ThreadEvents& thread = *m_threads[t];
+        std::lock_guard<std::mutex> threadLock(thread.mutex);
+        if (thread.events.empty()) continue;
+        out <<(isFirst ? "" : ",\n") <<"{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+            <<thread.id <<", \"args\": {\"name\": \"" <<thread.name <<"\"}}";
+        isFirst = false;
+        for (size_t i=0; i<thread.events.size(); ++i) {
+            const Event& event = thread.events[i];
+            out <<",\n{\"name\": \"" <<event.site->name <<"\", \"cat\": \"YAMPE\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                <<thread.id <<", \"ts\": " <<1e-3 * event.begin <<", \"dur\": " <<1e-3 * (event.end - event.begin) <<"}";
+        }
+        thread.events.clear();
+        thread.events.shrink_to_fit();
+    }
+    out <<"\n]}\n";
+    return bool(out);
+}
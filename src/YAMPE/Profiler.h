@@ -0,0 +1,149 @@
+/**
+ @file 		Profiler.h
+ @practical
+ @brief		Scoped timers with rolling statistics and Chrome trace capture.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "ofMain.h"
+
+/// Build with YAMPE_PROFILING=0 to compile every YAMPE_PROFILE_SCOPE out.
+#ifndef YAMPE_PROFILING
+#define YAMPE_PROFILING 1
+#endif
+
+namespace YAMPE {
+
+/**
+ A profile site is one instrumented scope in the code. It keeps the
+ durations of its last WINDOW runs, from any number of threads, without
+ locks, and summarises them on demand.
+ */
+class ProfileSite {
+
+public:
+    static const int WINDOW = 256;
+
+    struct Statistics {
+        float last, min, average, p99;  ///< over the window (s)
+        unsigned long count;            ///< runs since the profiler started
+    };
+
+    const std::string name;
+
+    explicit ProfileSite(const std::string& name);
+
+    void record(float seconds);
+    Statistics statistics() const;
+
+private:
+    std::atomic<float> m_samples[WINDOW];
+    std::atomic<unsigned long> m_count;
+};
+
+/**
+ The profiler holds every profile site and, while capturing, a record of
+ every run of every scope on every thread, written out as a Chrome
+ trace-event file (load it in chrome://tracing or Perfetto).
+
+ Outside a capture a scope costs two clock reads and a store into its
+ site. While capturing, each thread appends to its own event buffer.
+ */
+class Profiler {
+
+public:
+    std::atomic<bool> isEnabled;    ///< false to skip timing altogether
+
+    static Profiler& instance();
+    /// Time since the profiler started (ns).
+    static int64_t now();
+
+    /// The site with the given name, created on first use.
+    ProfileSite* site(const std::string& name);
+    /// Every site so far, in order of first use.
+    std::vector<ProfileSite*> sites();
+
+    /// Name the calling thread in traces.
+    void nameThread(const std::string& name);
+
+    void startCapture();
+    /// Stop capturing and write the trace; false if it cannot be written.
+    bool stopCapture(const std::string& fileName);
+    bool isCapturing() const { return m_isCapturing.load(std::memory_order_relaxed); }
+    /// Events dropped from the last capture because a buffer was full.
+    unsigned long droppedEvents() const { return m_dropped; }
+
+    /// Record one run of a scope in the capture (called by ProfileScope).
+    void capture(const ProfileSite* site, int64_t begin, int64_t end);
+
+private:
+    struct Event {
+        const ProfileSite* site;
+        int64_t begin, end;
+    };
+    struct ThreadEvents {
+        std::mutex mutex;           ///< uncontended except while a capture is written
+        int id;
+        std::string name;
+        std::vector<Event> events;
+    };
+    static const size_t MAX_EVENTS = 1 << 20;   ///< per thread per capture
+
+    std::mutex m_mutex;
+    std::vector<ofPtr<ProfileSite> > m_sites;
+    std::vector<ofPtr<ThreadEvents> > m_threads;
+    std::atomic<bool> m_isCapturing;
+    std::atomic<unsigned long> m_dropped;
+
+    Profiler();
+    Profiler(const Profiler&);
+    Profiler& operator=(const Profiler&);
+
+    ThreadEvents& threadEvents();
+};
+
+/**
+ Times the enclosing scope into a profile site (use YAMPE_PROFILE_SCOPE).
+ */
+class ProfileScope {
+
+public:
+    explicit ProfileScope(ProfileSite* site) :
+        m_site(site),
+        m_begin(Profiler::instance().isEnabled.load(std::memory_order_relaxed) ? Profiler::now() : -1) { }
+
+    ~ProfileScope() {
+        if (m_begin < 0) return;
+        int64_t end = Profiler::now();
+        m_site->record(1e-9f * (end - m_begin));
+        Profiler& profiler = Profiler::instance();
+        if (profiler.isCapturing()) profiler.capture(m_site, m_begin, end);
+    }
+
+private:
+    ProfileSite* m_site;
+    int64_t m_begin;
+};
+
+}	// namespace YAMPE
+
+#define YAMPE_PROFILE_JOIN2(a, b) a##b
+#define YAMPE_PROFILE_JOIN(a, b) YAMPE_PROFILE_JOIN2(a, b)
+
+#if YAMPE_PROFILING
+/// Time the rest of the enclosing scope under the given name (a string literal).
+#define YAMPE_PROFILE_SCOPE(name) \
+    static YAMPE::ProfileSite* YAMPE_PROFILE_JOIN(profileSite, __LINE__) = YAMPE::Profiler::instance().site(name); \
+    YAMPE::ProfileScope YAMPE_PROFILE_JOIN(profileScope, __LINE__)(YAMPE_PROFILE_JOIN(profileSite, __LINE__))
+#else
+#define YAMPE_PROFILE_SCOPE(name) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,288 @@
+/**
+ @file 		SpatialHash.cpp
+ @practical
+ @brief		Uniform grid broad phase and sphere contacts for a ParticleStore.
+ */
+
+#include <cfloat>
+#include "SpatialHash.h"
+#include "TaskScheduler.h"
+
+using namespace YAMPE;
+
+SpatialHash::SpatialHash(float cellSize, int tableSize) :
+    m_linkedEnd(0),
+    m_maxRadius(0.0f),
+    m_boxesChanged(false),
+    pairTests(0),
+    relinked(0)
+{
+    assert(tableSize > 0 && (tableSize & (tableSize-1)) == 0 && "Expected a power of two table size.");
+    m_mask = tableSize - 1;
+    m_head.assign(tableSize, -1);
+    m_boxHead.assign(tableSize, -1);
+    setCellSize(cellSize);
+}
+
+SpatialHash::CellKey SpatialHash::key(int x, int y, int z) {
+    // 21 bits per coordinate: cells wrap every two million along each axis
+    return (CellKey(x & 0x1FFFFF) << 42) | (CellKey(y & 0x1FFFFF) << 21) | CellKey(z & 0x1FFFFF);
+}
+
+int SpatialHash::bucket(CellKey key) const {
+    // Fibonacci hashing spreads neighbouring cells over the table
+    return int((key*0x9E3779B97F4A7C15ull) >> 32) & m_mask;
+}
+
+SpatialHash& SpatialHash::setCellSize(float cellSize) {
+    assert(cellSize > 0.0f && "Expected a positive cell size.");
+    m_cellSize = cellSize;
+    clear();
+    m_boxesChanged = true;
+    return *this;
+}
+
+void SpatialHash::clear() {
+    std::fill(m_head.begin(), m_head.end(), -1);
+    std::fill(m_linked.begin(), m_linked.end(), false);
+    m_linkedEnd = 0;
+    m_maxRadius = 0.0f;
+}
+
+void SpatialHash::link(int i, CellKey cell) {
+    int b = bucket(cell);
+    m_cell[i] = cell;
+    m_prev[i] = -1;
+    m_next[i] = m_head[b];
+    if (m_head[b] >= 0) m_prev[m_head[b]] = i;
+    m_head[b] = i;
+    m_linked[i] = true;
+    m_linkedEnd = std::max(m_linkedEnd, size_t(i) + 1);
+}
+
+void SpatialHash::unlink(int i) {
+    if (m_prev[i] >= 0) {
+        m_next[m_prev[i]] = m_next[i];
+    } else {
+        m_head[bucket(m_cell[i])] = m_next[i];
+    }
+    if (m_next[i] >= 0) m_prev[m_next[i]] = m_prev[i];
+    m_linked[i] = false;
+    while (m_linkedEnd > 0 && !m_linked[m_linkedEnd - 1]) m_linkedEnd--;
+}
+
+int SpatialHash::addBox(const ofVec3f& boxMin, const ofVec3f& boxMax) {
+    Box box = {boxMin, boxMax};
+    m_boxes.push_back(box);
+    m_boxesChanged = true;
+    return int(m_boxes.size()) - 1;
+}
+
+SpatialHash& SpatialHash::setBox(int index, const ofVec3f& boxMin, const ofVec3f& boxMax) {
+    assert(index >= 0 && index < int(m_boxes.size()) && "Expected a valid box index.");
+    Box& box = m_boxes[index];
+    if (box.min != boxMin || box.max != boxMax) {
+        box.min = boxMin;
+        box.max = boxMax;
+        m_boxesChanged = true;
+    }
+    return *this;
+}
+
+void SpatialHash::clearBoxes() {
+    m_boxes.clear();
+    m_boxesChanged = true;
+}
+
+void SpatialHash::insertBoxes() {
+    std::fill(m_boxHead.begin(), m_boxHead.end(), -1);
+    m_boxEntries.clear();
+    for (size_t k=0; k<m_boxes.size(); ++k) {
+        const Box& box = m_boxes[k];
+        for (int x=cell(box.min.x); x<=cell(box.max.x); ++x) {
+            for (int y=cell(box.min.y); y<=cell(box.max.y); ++y) {
+                for (int z=cell(box.min.z); z<=cell(box.max.z); ++z) {
+                    int b = bucket(key(x, y, z));
+                    BoxEntry entry = {int(k), key(x, y, z), m_boxHead[b]};
+                    m_boxHead[b] = int(m_boxEntries.size());
+                    m_boxEntries.push_back(entry);
+                }
+            }
+        }
+    }
+    m_boxesChanged = false;
+}
+
+void SpatialHash::update(const ParticleStore& particles, size_t begin, size_t end) {
+    assert(begin <= end && end <= particles.size() && "Expected a valid particle range.");
+
+    if (m_linked.size() < particles.size()) {
+        size_t n = particles.size();
+        m_next.resize(n, -1);
+        m_prev.resize(n, -1);
+        m_cell.resize(n, 0);
+        m_linked.resize(n, false);
+    }
+    if (2*particles.size() > m_head.size()) {
+        // keep the chains short: two buckets per particle, everything relinked
+        size_t tableSize = m_head.size();
+        while (tableSize < 2*particles.size()) tableSize *= 2;
+        m_mask = int(tableSize) - 1;
+        m_head.assign(tableSize, -1);
+        m_boxHead.assign(tableSize, -1);
+        std::fill(m_linked.begin(), m_linked.end(), false);
+        m_linkedEnd = 0;
+        m_boxesChanged = true;
+    }
+    if (m_boxesChanged) insertBoxes();
+
+    relinked = 0;
+    for (size_t i=begin; i<end; ++i) {
+        if (particles.inverseMass[i] <= 0.0f) {
+            if (m_linked[i]) unlink(i);
+            continue;
+        }
+        m_maxRadius = std::max(m_maxRadius, particles.radius[i]);
+        CellKey c = key(cell(particles.px[i]), cell(particles.py[i]), cell(particles.pz[i]));
+        if (m_linked[i]) {
+            if (c == m_cell[i]) continue;
+            unlink(i);
+        }
+        link(i, c);
+        relinked++;
+    }
+}
+
+void SpatialHash::findContacts(const ParticleStore& particles, std::vector<Contact>& contacts,
+                               TaskScheduler* scheduler, size_t grain) {
+    contacts.clear();
+    if (!scheduler) {
+        pairTests = collectContacts(particles, contacts, 0, m_linkedEnd);
+        return;
+    }
+
+    // each chunk collects its own contacts; joining them in chunk order keeps the result deterministic
+    size_t chunkCount = (m_linkedEnd + grain - 1)/grain;
+    if (m_chunkContacts.size() < chunkCount) m_chunkContacts.resize(chunkCount);
+    m_chunkTests.assign(chunkCount, 0);
+    scheduler->parallelFor(0, m_linkedEnd, grain, [&](size_t b, size_t e) {
+        std::vector<Contact>& chunk = m_chunkContacts[b/grain];
+        chunk.clear();
+        m_chunkTests[b/grain] = collectContacts(particles, chunk, b, e);
+    });
+    pairTests = 0;
+    for (size_t c=0; c<chunkCount; ++c) {
+        contacts.insert(contacts.end(), m_chunkContacts[c].begin(), m_chunkContacts[c].end());
+        pairTests += m_chunkTests[c];
+    }
+}
+
+int SpatialHash::collectContacts(const ParticleStore& particles, std::vector<Contact>& contacts,
+                                 size_t begin, size_t end) const {
+    int tests = 0;
+
+    // overlapping particles are at most two radii apart
+    int reach = std::max(1, int(ceilf(2.0f*m_maxRadius/m_cellSize)));
+
+    for (size_t n=begin; n<end; ++n) {
+        if (!m_linked[n]) continue;
+        int i = int(n);
+        ofVec3f p(particles.px[i], particles.py[i], particles.pz[i]);
+        float r = particles.radius[i];
+        int cx = cell(p.x), cy = cell(p.y), cz = cell(p.z);
+
+        // sphere-sphere, each pair once: only the cells after ours (and,
+        // in our own cell, only later particles), the other half of the
+        // neighbourhood finds us when its particles are searched
+        for (int dx=0; dx<=reach; ++dx) {
+            for (int dy=(dx>0 ? -reach : 0); dy<=reach; ++dy) {
+                for (int dz=(dx>0 || dy>0 ? -reach : 0); dz<=reach; ++dz) {
+                    bool own = dx==0 && dy==0 && dz==0;
+                    CellKey c = key(cx+dx, cy+dy, cz+dz);
+                    for (int j=m_head[bucket(c)]; j>=0; j=m_next[j]) {
+                        if (m_cell[j] != c || (own && j <= i)) continue;
+                        tests++;
+
+                        float reachSum = r + particles.radius[j];
+                        ofVec3f d(particles.px[j] - p.x, particles.py[j] - p.y, particles.pz[j] - p.z);
+                        float distanceSquared = d.lengthSquared();
+                        if (distanceSquared >= reachSum*reachSum) continue;
+
+                        // report the lower index first, the normal pointing from the higher to it
+                        int first = std::min(i, j), second = std::max(i, j);
+                        if (first == i) d = -d;
+                        float distance = sqrtf(distanceSquared);
+                        Contact contact;
+                        contact.first = first;
+                        contact.second = second;
+                        contact.box = -1;
+                        contact.normal = distance > 0.0f ? d/distance : ofVec3f(0, 1, 0);
+                        contact.penetration = reachSum - distance;
+                        ofVec3f q(particles.px[second], particles.py[second], particles.pz[second]);
+                        contact.point = q + contact.normal*(particles.radius[second] - 0.5f*contact.penetration);
+                        contacts.push_back(contact);
+                    }
+                }
+            }
+        }
+
+        // sphere-box, over the cells the sphere overlaps
+        if (m_boxes.empty()) continue;
+        for (int x=cell(p.x-r); x<=cell(p.x+r); ++x) {
+            for (int y=cell(p.y-r); y<=cell(p.y+r); ++y) {
+                for (int z=cell(p.z-r); z<=cell(p.z+r); ++z) {
+                    CellKey c = key(x, y, z);
+                    for (int e=m_boxHead[bucket(c)]; e>=0; e=m_boxEntries[e].next) {
+                        const BoxEntry& entry = m_boxEntries[e];
+                        if (entry.cell != c) continue;
+                        
+                        // test each box once, in the first cell shared with the sphere
+                        const Box& box = m_boxes[entry.box];
+                        if (x != std::max(cell(p.x-r), cell(box.min.x)) ||
+                            y != std::max(cell(p.y-r), cell(box.min.y)) ||
+                            z != std::max(cell(p.z-r), cell(box.min.z))) continue;
+                        tests++;
+
+                        ofVec3f closest(ofClamp(p.x, box.min.x, box.max.x),
+                                        ofClamp(p.y, box.min.y, box.max.y),
+                                        ofClamp(p.z, box.min.z, box.max.z));
+                        ofVec3f d = p - closest;
+                        float distanceSquared = d.lengthSquared();
+                        if (distanceSquared >= r*r) continue;
+
+                        Contact contact;
+                        contact.first = i;
+                        contact.second = -1;
+                        contact.box = entry.box;
+                        contact.point = closest;
+                        if (distanceSquared > 0.0f) {
+                            float distance = sqrtf(distanceSquared);
+                            contact.normal = d/distance;
+                            contact.penetration = r - distance;
+                        } else {
+                            // centre inside the box: push out through the nearest face
+                            float best = FLT_MAX;
+                            for (int axis=0; axis<3; ++axis) {
+                                float below = p[axis] - box.min[axis];
+                                float above = box.max[axis] - p[axis];
+                                if (below < best) {
+                                    best = below;
+                                    contact.normal = ofVec3f(0, 0, 0);
+                                    contact.normal[axis] = -1.0f;
+                                }
+                                if (above < best) {
+                                    best = above;
+                                    contact.normal = ofVec3f(0, 0, 0);
+                                    contact.normal[axis] = 1.0f;
+                                }
+                            }
+                            contact.penetration = r + best;
+                        }
+                        contacts.push_back(contact);
+                    }
+                }
+            }
+        }
+    }
+    return tests;
+}
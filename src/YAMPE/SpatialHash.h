@@ -0,0 +1,113 @@
+/**
+ @file 		SpatialHash.h
+ @practical
+ @brief		Uniform grid broad phase and sphere contacts for a ParticleStore.
+ */
+
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include "ofMain.h"
+#include "ParticleStore.h"
+
+namespace YAMPE {
+
+class TaskScheduler;
+
+/**
+ A contact between a particle and either another particle or a box, in
+ the form a resolver needs: the normal points away from the other body
+ towards the first particle, so pushing the first particle along it (and
+ the second against it) separates them.
+ */
+struct Contact {
+    int first;                  ///< index of the first particle
+    int second;                 ///< index of the other particle, or -1 for a box
+    int box;                    ///< index of the box, or -1 for a particle
+    ofVec3f normal;             ///< unit contact normal, towards first
+    ofVec3f point;              ///< point of contact (middle of the overlap)
+    float penetration;          ///< depth of the overlap along the normal
+};
+
+/**
+ A spatial hash sorts the particles of a store into the cells of a uniform
+ grid, hashed into a table with at least one bucket per particle, so that
+ contacts are found by testing each particle only against those in the
+ neighbouring cells rather than against every other particle.
+
+ Static axis aligned boxes (targets) are inserted into every cell they
+ overlap. Particles are relinked by update() only when they change cell,
+ so the per step cost is proportional to the number of particles, and the
+ contact search to the number of close pairs (it stops at the highest
+ linked particle, so unused slots at the end of a store cost nothing).
+
+ The cell size should be about the diameter of the largest particle; the
+ search widens automatically if particles are larger. Particles with zero
+ inverse mass (free pool slots, pinned anchors) take no part.
+ */
+class SpatialHash {
+
+private:
+    float m_cellSize;
+    int m_mask;                         ///< table size - 1 (the size is a power of two)
+    std::vector<int> m_head;            ///< first particle in each bucket, or -1
+    std::vector<int> m_next, m_prev;    ///< doubly linked bucket lists, per particle
+    typedef unsigned long long CellKey; ///< cell coordinates packed into one word
+    std::vector<CellKey> m_cell;        ///< cell of each particle
+    std::vector<bool> m_linked;
+    size_t m_linkedEnd;                 ///< one past the highest linked particle
+    float m_maxRadius;
+
+    struct Box { ofVec3f min, max; };
+    struct BoxEntry { int box; CellKey cell; int next; };
+    std::vector<Box> m_boxes;
+    std::vector<BoxEntry> m_boxEntries;
+    std::vector<int> m_boxHead;         ///< first box entry in each bucket, or -1
+    bool m_boxesChanged;
+    std::vector<std::vector<Contact> > m_chunkContacts;  ///< per chunk results of a parallel search
+    std::vector<int> m_chunkTests;
+
+    static CellKey key(int x, int y, int z);
+    int bucket(CellKey key) const;
+    int cell(float coordinate) const { return int(floorf(coordinate/m_cellSize)); }
+    void link(int i, CellKey cell);
+    void unlink(int i);
+    void insertBoxes();
+
+public:
+    int pairTests;                      ///< narrow phase tests in the last findContacts
+    int relinked;                       ///< particles that changed cell in the last update
+
+    SpatialHash(float cellSize = 0.25f, int tableSize = 4096);
+
+    float cellSize() const { return m_cellSize; }
+    /// Change the cell size (every particle is relinked on the next update).
+    SpatialHash& setCellSize(float cellSize);
+
+    /// Add a static box and return its index.
+    int addBox(const ofVec3f& boxMin, const ofVec3f& boxMax);
+    /// Move a box (cheap if it has not moved).
+    SpatialHash& setBox(int index, const ofVec3f& boxMin, const ofVec3f& boxMax);
+    size_t boxCount() const { return m_boxes.size(); }
+    void clearBoxes();
+
+    /// Bring the grid up to date with particles [begin, end) of the store.
+    void update(const ParticleStore& particles, size_t begin, size_t end);
+
+    /**
+     * Replace contacts with every sphere-sphere and sphere-box overlap, in
+     * the same order whether or not the search is split over a scheduler.
+     */
+    void findContacts(const ParticleStore& particles, std::vector<Contact>& contacts,
+                      TaskScheduler* scheduler = NULL, size_t grain = 1024);
+    
+    /// Append the contacts of particles [begin, end) and return the number of narrow phase tests.
+    int collectContacts(const ParticleStore& particles, std::vector<Contact>& contacts,
+                        size_t begin, size_t end) const;
+
+    void clear();
+};
+
+}	// namespace YAMPE
+
+#endif
@@ -0,0 +1,248 @@
+/**
+ @file 		SphereBatch.cpp
+ @practical
+ @brief		Instanced rendering of many spheres in one draw call.
+ */
+
+#include "SphereBatch.h"
+
+using namespace YAMPE;
+
+namespace {
+
+// Vertex attribute locations of the per-instance data.
+const int SPHERE_LOCATION = 5;
+const int COLOR_LOCATION = 6;
+
+// Fixed function (GL 2.1) pipeline, as set up by ofSetupOpenGL.
+const char* vertexShader120 =
+    "#version 120\n"
+    "attribute vec4 sphere;\n"
+    "attribute vec4 sphereColor;\n"
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "    color = sphereColor;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix*vec4(gl_Vertex.xyz*sphere.w + sphere.xyz, 1.0);\n"
+    "}\n";
+
+const char* fragmentShader120 =
+    "#version 120\n"
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "    gl_FragColor = color;\n"
+    "}\n";
+
+// Programmable (GL 3.2+) renderer.
+const char* vertexShader150 =
+    "#version 150\n"
+    "uniform mat4 modelViewProjectionMatrix;\n"
+    "in vec4 position;\n"
+    "in vec4 sphere;\n"
+    "in vec4 sphereColor;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "    color = sphereColor;\n"
+    "    gl_Position = modelViewProjectionMatrix*vec4(position.xyz*sphere.w + sphere.xyz, 1.0);\n"
+    "}\n";
+
+const char* fragmentShader150 =
+    "#version 150\n"
+    "in vec4 color;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    fragColor = color;\n"
+    "}\n";
+
+}   // namespace
+
+SphereBatch::SphereBatch() :
+    m_isInstancingAvailable(false),
+    m_hasView(false),
+    m_pixelsPerUnit(0.0f),
+    useInstancing(true)
+{
+    for (int level=0; level<LEVEL_COUNT; ++level) {
+        m_numIndices[level] = 0;
+        m_resolution[level] = 0;
+        m_statistics.drawn[level] = 0;
+    }
+    m_statistics.culled = 0;
+    levelPixels[HIGH] = 16.0f;
+    levelPixels[MEDIUM] = 4.0f;
+    levelPixels[LOW] = 1.0f;
+}
+
+void SphereBatch::setup(int resolution) {
+    
+    // coarser spheres for smaller sizes on screen, and a single point
+    m_resolution[HIGH] = resolution;
+    m_resolution[MEDIUM] = std::max(4, resolution/2);
+    m_resolution[LOW] = std::max(3, resolution/4);
+    for (int level=0; level<POINT; ++level) {
+        ofMesh mesh = ofSpherePrimitive(1.0f, m_resolution[level]).getMesh();
+        m_vbo[level].setMesh(mesh, GL_STATIC_DRAW);
+        m_numIndices[level] = mesh.getNumIndices();
+    }
+    ofMesh point;
+    point.addVertex(ofVec3f(0, 0, 0));
+    m_vbo[POINT].setMesh(point, GL_STATIC_DRAW);
+    m_numIndices[POINT] = 0;
+    
+    bool isProgrammable = ofIsGLProgrammableRenderer();
+    m_shader.setupShaderFromSource(GL_VERTEX_SHADER, isProgrammable ? vertexShader150 : vertexShader120);
+    m_shader.setupShaderFromSource(GL_FRAGMENT_SHADER, isProgrammable ? fragmentShader150 : fragmentShader120);
+    m_shader.bindAttribute(SPHERE_LOCATION, "sphere");
+    m_shader.bindAttribute(COLOR_LOCATION, "sphereColor");
+    if (isProgrammable) m_shader.bindDefaults();
+    m_isInstancingAvailable = m_shader.linkProgram();
+    
+    if (!m_isInstancingAvailable) {
+        ofLogWarning("SphereBatch") <<"instancing unavailable, drawing spheres one at a time";
+    }
+}
+
+void SphereBatch::clear() {
+    m_spheres.clear();
+    m_colors.clear();
+}
+
+void SphereBatch::reserve(size_t capacity) {
+    m_spheres.reserve(capacity);
+    m_colors.reserve(capacity);
+}
+
+void SphereBatch::add(const ofVec3f& position, float radius, const ofColor& color) {
+    m_spheres.push_back(ofVec4f(position.x, position.y, position.z, radius));
+    m_colors.push_back(ofFloatColor(color));
+}
+
+void SphereBatch::add(const Particle& particle) {
+    if (particle.visible) add(particle.position, particle.radius, particle.getBodyColor());
+}
+
+void SphereBatch::add(const ParticleStore& store, size_t begin, size_t end, const ofColor& color) {
+    assert(end <= store.size() && "Expected particle range within the store");
+    ofFloatColor floatColor(color);
+    for (size_t i=begin; i<end; ++i) {
+        m_spheres.push_back(ofVec4f(store.px[i], store.py[i], store.pz[i], store.radius[i]));
+        m_colors.push_back(floatColor);
+    }
+}
+
+void SphereBatch::setView(const ofCamera& camera) {
+    ofRectangle viewport = ofGetCurrentViewport();
+    setView(camera.getModelViewProjectionMatrix(),
+            0.5f * viewport.height / tan(ofDegToRad(0.5f * camera.getFov())));
+}
+
+/**
+ * Planes of the frustum from the columns of the matrix (clip = v*M), so a
+ * point is inside if it is on the positive side of all six.
+ */
+void SphereBatch::setView(const ofMatrix4x4& m, float pixelsPerUnit) {
+    ofVec4f column[4];
+    for (int j=0; j<4; ++j) column[j].set(m(0, j), m(1, j), m(2, j), m(3, j));
+    m_planes[0] = column[3] + column[0];    // left
+    m_planes[1] = column[3] - column[0];    // right
+    m_planes[2] = column[3] + column[1];    // bottom
+    m_planes[3] = column[3] - column[1];    // top
+    m_planes[4] = column[3] + column[2];    // near
+    m_planes[5] = column[3] - column[2];    // far
+    for (int i=0; i<6; ++i) {
+        float length = ofVec3f(m_planes[i].x, m_planes[i].y, m_planes[i].z).length();
+        if (length > 0.0f) m_planes[i] /= length;
+    }
+    // clip w is the depth along the view direction
+    m_depth = column[3];
+    m_pixelsPerUnit = pixelsPerUnit;
+    m_hasView = true;
+}
+
+void SphereBatch::classify() {
+    for (int level=0; level<LEVEL_COUNT; ++level) {
+        m_levelSpheres[level].clear();
+        m_levelColors[level].clear();
+        m_statistics.drawn[level] = 0;
+    }
+    m_statistics.culled = 0;
+    
+    for (size_t i=0; i<m_spheres.size(); ++i) {
+        const ofVec4f& sphere = m_spheres[i];
+        int level = HIGH;
+        if (m_hasView) {
+            bool isOutside = false;
+            for (int p=0; p<6 && !isOutside; ++p) {
+                const ofVec4f& plane = m_planes[p];
+                isOutside = plane.x*sphere.x + plane.y*sphere.y + plane.z*sphere.z + plane.w < -sphere.w;
+            }
+            if (isOutside) {
+                m_statistics.culled++;
+                continue;
+            }
+            
+            // radius on screen, taking spheres through the near plane as large
+            float depth = m_depth.x*sphere.x + m_depth.y*sphere.y + m_depth.z*sphere.z + m_depth.w;
+            float pixels = depth > sphere.w ? sphere.w * m_pixelsPerUnit / depth : levelPixels[HIGH];
+            level = POINT;
+            while (level > HIGH && pixels >= levelPixels[level - 1]) level--;
+        }
+        m_levelSpheres[level].push_back(sphere);
+        m_levelColors[level].push_back(m_colors[i]);
+        m_statistics.drawn[level]++;
+    }
+}
+
+void SphereBatch::draw() {
+    classify();
+    if (m_spheres.empty()) return;
+    
+    if (!isInstanced()) {
+        // the style holds the sphere resolution, which is only changed with a view
+        ofPushStyle();
+        for (int level=0; level<POINT; ++level) {
+            if (m_levelSpheres[level].empty()) continue;
+            if (m_hasView) ofSetSphereResolution(m_resolution[level]);
+            for (size_t i=0; i<m_levelSpheres[level].size(); ++i) {
+                const ofVec4f& sphere = m_levelSpheres[level][i];
+                ofSetColor(m_levelColors[level][i]);
+                ofDrawSphere(ofVec3f(sphere.x, sphere.y, sphere.z), sphere.w);
+            }
+        }
+        ofPopStyle();
+        if (!m_levelSpheres[POINT].empty()) {
+            ofMesh points;
+            points.setMode(OF_PRIMITIVE_POINTS);
+            for (size_t i=0; i<m_levelSpheres[POINT].size(); ++i) {
+                const ofVec4f& sphere = m_levelSpheres[POINT][i];
+                points.addVertex(ofVec3f(sphere.x, sphere.y, sphere.z));
+                points.addColor(m_levelColors[POINT][i]);
+            }
+            points.draw();
+        }
+        return;
+    }
+    
+    m_shader.begin();
+    for (int level=0; level<LEVEL_COUNT; ++level) drawLevel(level);
+    m_shader.end();
+}
+
+/**
+ * One instanced draw of the spheres at a level.
+ */
+void SphereBatch::drawLevel(int level) {
+    int count = m_levelSpheres[level].size();
+    if (count == 0) return;
+    
+    ofVbo& vbo = m_vbo[level];
+    vbo.setAttributeData(SPHERE_LOCATION, &m_levelSpheres[level][0].x, 4, count, GL_STREAM_DRAW, sizeof(ofVec4f));
+    vbo.setAttributeDivisor(SPHERE_LOCATION, 1);
+    vbo.setAttributeData(COLOR_LOCATION, &m_levelColors[level][0].r, 4, count, GL_STREAM_DRAW, sizeof(ofFloatColor));
+    vbo.setAttributeDivisor(COLOR_LOCATION, 1);
+    
+    if (level == POINT) {
+        vbo.drawInstanced(GL_POINTS, 0, 1, count);
+    } else {
+        vbo.drawElementsInstanced(GL_TRIANGLES, m_numIndices[level], count);
+    }
+}
@@ -0,0 +1,101 @@
+/**
+ @file 		SphereBatch.h
+ @practical
+ @brief		Instanced rendering of many spheres in one draw call.
+ */
+
+#ifndef SPHERE_BATCH_H
+#define SPHERE_BATCH_H
+
+#include "ofMain.h"
+#include "Particle.h"
+#include "ParticleStore.h"
+
+namespace YAMPE {
+
+/**
+ A sphere batch draws many coloured spheres with a single instanced draw
+ call per level of detail.
+ 
+ Sphere meshes are uploaded once; each frame the position, radius and
+ colour of every sphere are collected with add() and uploaded as
+ per-instance attributes, then draw() issues one call per level for the
+ whole batch. If instancing is unavailable (the shader fails to compile)
+ or has been switched off with useInstancing, draw() falls back to one
+ ofDrawSphere per sphere, exactly as Particle::draw does.
+ 
+ Once setView() has been given the camera, draw() skips the spheres
+ outside its frustum and draws each of the others with a mesh fine enough
+ for its size on screen, down to a single point for spheres smaller than
+ a pixel. Without a view every sphere is drawn at full resolution.
+ */
+class SphereBatch {
+    
+public:
+    enum Level {HIGH, MEDIUM, LOW, POINT, LEVEL_COUNT};
+    
+    /// Spheres drawn at each level and culled in the last draw().
+    struct Statistics {
+        int drawn[LEVEL_COUNT];
+        int culled;
+    };
+    
+private:
+    ofVbo m_vbo[LEVEL_COUNT];
+    int m_numIndices[LEVEL_COUNT];
+    ofShader m_shader;
+    bool m_isInstancingAvailable;
+    int m_resolution[LEVEL_COUNT];
+    
+    std::vector<ofVec4f> m_spheres;         ///< Position (xyz) and radius (w) of each sphere.
+    std::vector<ofFloatColor> m_colors;
+    std::vector<ofVec4f> m_levelSpheres[LEVEL_COUNT];   ///< Spheres to draw at each level.
+    std::vector<ofFloatColor> m_levelColors[LEVEL_COUNT];
+    
+    bool m_hasView;
+    ofVec4f m_planes[6];                    ///< Frustum planes, normals pointing in.
+    ofVec4f m_depth;                        ///< Depth in front of the camera as a plane.
+    float m_pixelsPerUnit;                  ///< Pixels spanned by a unit length at unit depth.
+    Statistics m_statistics;
+    
+    void drawLevel(int level);
+    
+public:
+    bool useInstancing;                     ///< Draw with instancing when available.
+    float levelPixels[POINT];               ///< Least radius on screen (pixels) for HIGH, MEDIUM and LOW.
+    
+    SphereBatch();
+    
+    /// Build the sphere meshes and shader; call once a GL context exists.
+    void setup(int resolution = 12);
+    
+    bool isInstanced() const { return useInstancing && m_isInstancingAvailable; }
+    size_t size() const { return m_spheres.size(); }
+    
+    void clear();
+    void reserve(size_t capacity);
+    
+    void add(const ofVec3f& position, float radius, const ofColor& color);
+    void add(const Particle& particle);
+    /// Add the particles [begin, end) of a store, all in the same colour.
+    void add(const ParticleStore& store, size_t begin, size_t end, const ofColor& color);
+    
+    /// Cull and choose levels for the given camera (and current viewport) in the draws that follow.
+    void setView(const ofCamera& camera);
+    /// As setView(camera), from the model view projection matrix (row vectors, as ofMatrix4x4)
+    /// and the height of the viewport in pixels over 2 tan(fov/2).
+    void setView(const ofMatrix4x4& modelViewProjection, float pixelsPerUnit);
+    /// Draw every sphere at full resolution from now on.
+    void clearView() { m_hasView = false; }
+    
+    /// Sort the spheres added since the last clear() into levels, culling those out of view.
+    void classify();
+    /// Draw every sphere added since the last clear().
+    void draw();
+    
+    const Statistics& statistics() const { return m_statistics; }
+};
+    
+}	// namespace YAMPE
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ @file 		StepPath.cpp
+ @practical
+ @brief		Path of a particle within one integration step, for event detection.
+ */
+
+#include "StepPath.h"
+
+using namespace YAMPE;
+
+/// Bisection steps to refine a crossing; 2^-40 of a step is below float precision.
+static const int BISECTION_STEPS = 40;
+
+/// Slack when testing that a point on one face of a box lies within the others.
+static const float BOX_TOLERANCE = 1e-5f;
+
+StepPath::StepPath(const ofVec3f& startPosition, const ofVec3f& startVelocity,
+                   const ofVec3f& endPosition, const ofVec3f& endVelocity, float dt) :
+    m_dt(dt),
+    m_endPosition(endPosition),
+    m_endVelocity(endVelocity)
+{
+    assert(dt > 0.0f && "Expected a positive step for a step path.");
+
+    // Hermite basis expanded into powers of u = s/dt.
+    m_c[0] = startPosition;
+    m_c[1] = dt*startVelocity;
+    m_c[2] = 3.0f*(endPosition - startPosition) - dt*(2.0f*startVelocity + endVelocity);
+    m_c[3] = 2.0f*(startPosition - endPosition) + dt*(startVelocity + endVelocity);
+}
+
+ofVec3f StepPath::position(float s) const {
+    // the curve only approximates the end to round off
+    if (s >= m_dt) return m_endPosition;
+    float u = s/m_dt;
+    return m_c[0] + u*(m_c[1] + u*(m_c[2] + u*m_c[3]));
+}
+
+ofVec3f StepPath::velocity(float s) const {
+    if (s >= m_dt) return m_endVelocity;
+    float u = s/m_dt;
+    return (m_c[1] + u*(2.0f*m_c[2] + 3.0f*u*m_c[3]))/m_dt;
+}
+
+int StepPath::falls(const ofVec3f& normal, float offset, float u[3]) const {
+
+    // f(u) = n.p(u) - offset, in double so that shallow crossings keep their precision
+    double a0 = double(normal.dot(m_c[0])) - offset;
+    double a1 = normal.dot(m_c[1]);
+    double a2 = normal.dot(m_c[2]);
+    double a3 = normal.dot(m_c[3]);
+
+    // split [0,1] where f'(u) = a1 + 2 a2 u + 3 a3 u^2 vanishes
+    double knots[4] = {0.0, 1.0, 1.0, 1.0};
+    int knotCount = 1;
+    double roots[2];
+    int rootCount = 0;
+    if (fabs(a3) > 1e-12) {
+        double disc = a2*a2 - 3.0*a1*a3;
+        if (disc >= 0.0) {
+            double sq = sqrt(disc);
+            roots[rootCount++] = (-a2 - sq)/(3.0*a3);
+            roots[rootCount++] = (-a2 + sq)/(3.0*a3);
+            if (roots[0] > roots[1]) std::swap(roots[0], roots[1]);
+        }
+    } else if (fabs(a2) > 1e-12) {
+        roots[rootCount++] = -a1/(2.0*a2);
+    }
+    for (int i=0; i<rootCount; ++i) {
+        if (roots[i] > 0.0 && roots[i] < 1.0) knots[knotCount++] = roots[i];
+    }
+    knots[knotCount++] = 1.0;
+
+    // f is monotonic between knots: look for a fall through zero in each piece
+    int count = 0;
+    for (int k=0; k+1<knotCount; ++k) {
+        double lo = knots[k], hi = knots[k+1];
+        double fLo = a0 + lo*(a1 + lo*(a2 + lo*a3));
+        double fHi = a0 + hi*(a1 + hi*(a2 + hi*a3));
+        if (!(fLo > 0.0 && fHi <= 0.0)) continue;
+        for (int i=0; i<BISECTION_STEPS; ++i) {
+            double mid = 0.5*(lo + hi);
+            double fMid = a0 + mid*(a1 + mid*(a2 + mid*a3));
+            if (fMid > 0.0) lo = mid; else hi = mid;
+        }
+        u[count++] = float(hi);
+    }
+    return count;
+}
+
+float StepPath::crossPlane(const ofVec3f& normal, float offset) const {
+    float u[3];
+    if (falls(normal, offset, u) == 0) return -1.0f;
+    return u[0]*m_dt;
+}
+
+float StepPath::enterBox(const ofVec3f& boxMin, const ofVec3f& boxMax) const {
+
+    const ofVec3f& start = m_c[0];
+    if (start.x >= boxMin.x && start.x <= boxMax.x &&
+        start.y >= boxMin.y && start.y <= boxMax.y &&
+        start.z >= boxMin.z && start.z <= boxMax.z) return -1.0f;
+
+    // the path enters through a face: crossing its plane inwards while inside the other slabs
+    float earliest = 2.0f;
+    for (int axis=0; axis<3; ++axis) {
+        for (int side=0; side<2; ++side) {
+            ofVec3f normal(0, 0, 0);
+            normal[axis] = side==0 ? -1.0f : 1.0f;
+            float offset = side==0 ? -boxMin[axis] : boxMax[axis];
+
+            float u[3];
+            int count = falls(normal, offset, u);
+            for (int i=0; i<count && u[i]<earliest; ++i) {
+                ofVec3f p = m_c[0] + u[i]*(m_c[1] + u[i]*(m_c[2] + u[i]*m_c[3]));
+                bool inside = true;
+                for (int other=0; other<3; ++other) {
+                    if (other == axis) continue;
+                    if (p[other] < boxMin[other] - BOX_TOLERANCE ||
+                        p[other] > boxMax[other] + BOX_TOLERANCE) inside = false;
+                }
+                if (inside) {
+                    earliest = u[i];
+                    break;
+                }
+            }
+        }
+    }
+    return earliest <= 1.0f ? earliest*m_dt : -1.0f;
+}
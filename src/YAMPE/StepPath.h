@@ -0,0 +1,64 @@
+/**
+ @file 		StepPath.h
+ @practical
+ @brief		Path of a particle within one integration step, for event detection.
+ */
+
+#ifndef STEP_PATH_H
+#define STEP_PATH_H
+
+#include "ofMain.h"
+
+namespace YAMPE {
+
+/**
+ A step path is the cubic Hermite curve through the position and velocity
+ of a particle at the start and end of one integration step.
+
+ Under constant acceleration (a ballistic flight) the curve is the exact
+ parabola whenever the integrator is exact, so crossing times found on it
+ do not depend on the step size. With other forces it is a third order
+ interpolant of the step, much closer than clamping the end position.
+
+ Events are found by root finding on the curve: it is split into pieces
+ where it is monotonic along the surface normal, and the first piece that
+ changes sign is refined by bisection. Times are measured in seconds from
+ the start of the step, and are negative when there is no event.
+ */
+class StepPath {
+
+private:
+    float m_dt;                 ///< Length of the step (s).
+    ofVec3f m_c[4];             ///< Coefficients of the curve in u = s/dt.
+    ofVec3f m_endPosition, m_endVelocity;
+
+    /// Times (as u) at which n.p(u) falls through offset, in order; returns how many.
+    int falls(const ofVec3f& normal, float offset, float u[3]) const;
+
+public:
+    StepPath(const ofVec3f& startPosition, const ofVec3f& startVelocity,
+             const ofVec3f& endPosition, const ofVec3f& endVelocity, float dt);
+
+    float duration() const { return m_dt; }
+
+    /// Position s seconds into the step (exactly the end position from the end of the step).
+    ofVec3f position(float s) const;
+    /// Velocity s seconds into the step (exactly the end velocity from the end of the step).
+    ofVec3f velocity(float s) const;
+
+    /**
+     * Earliest time the path passes from the front of the plane n.p = offset
+     * (the side the normal points to) to the back of it, or -1.
+     */
+    float crossPlane(const ofVec3f& normal, float offset) const;
+
+    /**
+     * Earliest time the path enters the axis aligned box [boxMin, boxMax]
+     * from outside, or -1. A path that starts inside the box does not enter it.
+     */
+    float enterBox(const ofVec3f& boxMin, const ofVec3f& boxMax) const;
+};
+
+}	// namespace YAMPE
+
+#endif
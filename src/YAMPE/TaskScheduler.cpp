@@ -0,0 +1,132 @@
+/**
+ @file 		TaskScheduler.cpp
+ @practical
+ @brief		Work stealing thread pool for data parallel physics phases.
+ */
+
+#include "TaskScheduler.h"
+#include "Profiler.h"
+
+using namespace YAMPE;
+
+TaskScheduler::TaskScheduler(int threadCount) :
+    steals(0),
+    m_remaining(0),
+    m_generation(0),
+    m_quit(false)
+{
+    start(threadCount);
+}
+
+TaskScheduler::~TaskScheduler() {
+    stop();
+}
+
+TaskScheduler& TaskScheduler::setThreadCount(int threadCount) {
+    stop();
+    start(threadCount);
+    return *this;
+}
+
+void TaskScheduler::start(int threadCount) {
+    if (threadCount <= 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    m_quit = false;
+    m_queues.clear();
+    for (int i=0; i<threadCount; ++i) m_queues.push_back(ofPtr<Queue>(new Queue()));
+    for (int i=1; i<threadCount; ++i) m_workers.push_back(std::thread(&TaskScheduler::work, this, i));
+}
+
+void TaskScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (size_t i=0; i<m_workers.size(); ++i) m_workers[i].join();
+    m_workers.clear();
+}
+
+void TaskScheduler::parallelFor(size_t begin, size_t end, size_t grain, const RangeTask& task) {
+    assert(grain > 0 && "Expected a positive grain.");
+    if (begin >= end) return;
+
+    size_t chunkCount = (end - begin + grain - 1)/grain;
+    if (chunkCount == 1 || m_queues.size() == 1) {
+        // same chunks, one after another
+        for (size_t b=begin; b<end; b+=grain) task(b, std::min(end, b + grain));
+        return;
+    }
+
+    // deal out contiguous runs of chunks so that each thread starts on its own part of memory
+    size_t threads = m_queues.size();
+    m_remaining = chunkCount;
+    for (size_t q=0; q<threads; ++q) {
+        std::lock_guard<std::mutex> lock(m_queues[q]->mutex);
+        for (size_t c=q*chunkCount/threads; c<(q+1)*chunkCount/threads; ++c) {
+            size_t b = begin + c*grain;
+            Chunk chunk = {b, std::min(end, b + grain), &task};
+            m_queues[q]->chunks.push_back(chunk);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    // help out, then wait for chunks still running on the workers
+    while (runOne(0)) { }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_remaining == 0; });
+}
+
+bool TaskScheduler::runOne(int self) {
+    Chunk chunk;
+    bool found = false;
+    {
+        Queue& own = *m_queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            found = true;
+        }
+    }
+    for (size_t k=1; !found && k<m_queues.size(); ++k) {
+        Queue& victim = *m_queues[(self + k) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            found = true;
+            steals++;
+        }
+    }
+    if (!found) return false;
+
+    (*chunk.task)(chunk.begin, chunk.end);
+    if (--m_remaining == 0) {
+        // take the lock so the caller cannot miss the notification
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done.notify_all();
+    }
+    return true;
+}
+
+void TaskScheduler::work(int self) {
+    std::ostringstream name;
+    name <<"worker " <<self;
+    Profiler::instance().nameThread(name.str());
+    
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+            if (m_quit) return;
+            seen = m_generation;
+        }
+        while (runOne(self)) { }
+    }
+}
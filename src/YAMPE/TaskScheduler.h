@@ -0,0 +1,80 @@
+/**
+ @file 		TaskScheduler.h
+ @practical
+ @brief		Work stealing thread pool for data parallel physics phases.
+ */
+
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ofMain.h"
+
+namespace YAMPE {
+
+/**
+ A task scheduler runs a range task over [begin, end) split into chunks,
+ on a pool of worker threads plus the calling thread.
+
+ Each thread has its own queue of chunks: it takes work from the back of
+ its own queue and, when that is empty, steals from the front of another,
+ so threads that finish early take over the work of slow ones.
+
+ Chunk boundaries depend only on the grain, never on the number of
+ threads, so as long as each chunk writes only its own range the result
+ is identical whatever the thread count (including one).
+ */
+class TaskScheduler {
+
+public:
+    typedef std::function<void(size_t begin, size_t end)> RangeTask;
+
+    std::atomic<unsigned long> steals;  ///< chunks run by a thread other than the one queued to
+
+    /// Start threadCount - 1 workers (0 means one thread per core).
+    explicit TaskScheduler(int threadCount = 0);
+    ~TaskScheduler();
+
+    /// Threads taking part in parallelFor, including the caller.
+    int threadCount() const { return int(m_queues.size()); }
+    /// Stop the workers and start a new pool (0 means one thread per core).
+    TaskScheduler& setThreadCount(int threadCount);
+
+    /// Run task on every chunk of at most grain items of [begin, end) and wait for all of them.
+    void parallelFor(size_t begin, size_t end, size_t grain, const RangeTask& task);
+
+private:
+    struct Chunk {
+        size_t begin, end;
+        const RangeTask* task;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    std::vector<ofPtr<Queue> > m_queues;        ///< one per thread; 0 belongs to the caller
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;             ///< new chunks (or quit) for the workers
+    std::condition_variable m_done;             ///< the last chunk has finished
+    std::atomic<size_t> m_remaining;            ///< chunks queued or running
+    unsigned long m_generation;                 ///< parallelFor calls, to wake the workers
+    bool m_quit;
+
+    void start(int threadCount);
+    void stop();
+    void work(int self);
+    /// Run one chunk from our queue or stolen from another; false if there was none.
+    bool runOne(int self);
+};
+
+}	// namespace YAMPE
+
+#endif
@@ -0,0 +1,46 @@
+/**
+ @file 		TelemetryChannel.cpp
+ @practical
+ @brief		Lock-free ring buffer of samples for plotting.
+ */
+
+#include "TelemetryChannel.h"
+
+using namespace YAMPE;
+
+TelemetryChannel::TelemetryChannel(size_t capacity) :
+    m_values(new std::atomic<float>[capacity > 0 ? capacity : 1]),
+    m_capacity(capacity > 0 ? capacity : 1),
+    m_written(0)
+{
+    clear();
+}
+
+void TelemetryChannel::append(float value) {
+    size_t n = m_written.load(std::memory_order_relaxed);
+    m_values[n % m_capacity].store(value, std::memory_order_relaxed);
+    // publish the sample to the consumer
+    m_written.store(n + 1, std::memory_order_release);
+}
+
+void TelemetryChannel::clear() {
+    for (size_t i=0; i<m_capacity; ++i) {
+        m_values[i].store(0.0f, std::memory_order_relaxed);
+    }
+    m_written.store(0, std::memory_order_release);
+}
+
+TelemetryChannel::View TelemetryChannel::view() const {
+    // Before the buffer has wrapped the view starts in the (zeroed) unwritten
+    // slots, so the newest sample is always drawn at the right hand end.
+    View view;
+    view.channel = this;
+    view.start = written();
+    view.count = int(m_capacity);
+    return view;
+}
+
+float TelemetryChannel::latest() const {
+    size_t n = written();
+    return n > 0 ? sample(n - 1) : 0.0f;
+}
@@ -0,0 +1,84 @@
+/**
+ @file 		TelemetryChannel.h
+ @practical
+ @brief		Lock-free ring buffer of samples for plotting.
+ */
+
+#ifndef TELEMETRY_CHANNEL_H
+#define TELEMETRY_CHANNEL_H
+
+#include <atomic>
+#include <memory>
+#include <cassert>
+
+namespace YAMPE {
+
+/**
+ A telemetry channel is a circular buffer of the most recent samples of a
+ simulation quantity (height, energy, ...) for display in a plot.
+ 
+ Appending a sample is O(1). A channel is single-producer/single-consumer
+ safe without locks: one thread (typically physics) calls append() while
+ another (typically the UI) takes a view() and plots it. A view reads the
+ samples in place, oldest first, so nothing is copied or shifted; use it
+ with the callback form of ImGui::PlotHistogram / PlotLines:
+ 
+    TelemetryChannel::View view = channel.view();
+    ImGui::PlotHistogram("Height", &TelemetryChannel::View::valueAt, &view, view.count);
+ 
+ If the producer overtakes a view while it is plotted the oldest few bars
+ may already show newer samples; no value is ever torn.
+ */
+class TelemetryChannel {
+    
+private:
+    std::unique_ptr<std::atomic<float>[]> m_values;
+    size_t m_capacity;
+    std::atomic<size_t> m_written;          ///< Total number of samples appended.
+    
+    TelemetryChannel(const TelemetryChannel&);
+    TelemetryChannel& operator=(const TelemetryChannel&);
+    
+public:
+    
+    /// Samples of a channel, oldest first, as seen at the time view() was called.
+    struct View {
+        const TelemetryChannel* channel;
+        size_t start;                       ///< Sample number of the oldest sample in the view.
+        int count;
+        
+        float operator[](int i) const { return channel->sample(start + i); }
+        
+        /// Getter matching the ImGui plot callback signature; data is a View*.
+        static float valueAt(void* data, int i) {
+            return (*static_cast<const View*>(data))[i];
+        }
+    };
+    
+    /// Create a channel holding the last capacity samples, all initially zero.
+    explicit TelemetryChannel(size_t capacity = 1000);
+    
+    size_t capacity() const { return m_capacity; }
+    size_t written() const { return m_written.load(std::memory_order_acquire); }
+    
+    /// Producer: append a sample, overwriting the oldest.
+    void append(float value);
+    
+    /// Producer: forget all samples (not safe while a consumer is reading).
+    void clear();
+    
+    /// Consumer: the last capacity() samples, oldest first (zero before anything was written).
+    View view() const;
+    
+    /// Consumer: the most recent sample.
+    float latest() const;
+    
+private:
+    float sample(size_t n) const {
+        return m_values[n % m_capacity].load(std::memory_order_relaxed);
+    }
+};
+    
+}	// namespace YAMPE
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ @file 		Trail.cpp
+ @practical
+ @brief		Fixed capacity ring buffer of past particle positions.
+ */
+
+#include "Trail.h"
+
+using namespace YAMPE;
+
+Trail::Trail(size_t capacity, int stepInterval, float distanceInterval) :
+    m_points(capacity > 0 ? capacity : 1),
+    m_head(0),
+    m_size(0),
+    m_stepsSinceSample(0),
+    m_sampledLastStep(false),
+    stepInterval(stepInterval),
+    distanceInterval(distanceInterval)
+{ }
+
+Trail& Trail::setCapacity(size_t capacity) {
+    assert(capacity > 0 && "Expected a trail with positive capacity.");
+    m_points.assign(capacity, ofVec3f::zero());
+    clear();
+    return *this;
+}
+
+Trail& Trail::setStepInterval(int stepInterval) {
+    assert(stepInterval > 0 && "Expected a positive step interval.");
+    this->stepInterval = stepInterval;
+    return *this;
+}
+
+Trail& Trail::setDistanceInterval(float distanceInterval) {
+    this->distanceInterval = distanceInterval;
+    return *this;
+}
+
+void Trail::clear() {
+    m_head = 0;
+    m_size = 0;
+    m_stepsSinceSample = 0;
+    m_sampledLastStep = false;
+}
+
+void Trail::push(const ofVec3f& position) {
+    m_head = (m_head + 1) % m_points.size();
+    m_points[m_head] = position;
+    if (m_size < m_points.size()) m_size++;
+    m_stepsSinceSample = 0;
+}
+
+bool Trail::sample(const ofVec3f& position) {
+    m_stepsSinceSample++;
+    
+    bool due;
+    if (m_size == 0) {
+        due = true;
+    } else if (distanceInterval > 0.0f) {
+        due = position.squareDistance(m_points[m_head]) >= distanceInterval*distanceInterval;
+    } else {
+        due = m_stepsSinceSample >= stepInterval;
+    }
+    
+    if (due) push(position);
+    m_sampledLastStep = due;
+    return due;
+}
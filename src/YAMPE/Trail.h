@@ -0,0 +1,71 @@
+/**
+ @file 		Trail.h
+ @practical
+ @brief		Fixed capacity ring buffer of past particle positions.
+ */
+
+#ifndef TRAIL_H
+#define TRAIL_H
+
+#include "ofMain.h"
+
+namespace YAMPE {
+
+/**
+ A trail records the recent positions of a particle in a fixed capacity
+ ring buffer.
+ 
+ Adding a position is O(1): the oldest entry is overwritten rather than
+ every entry being shifted along, and entries are plain positions rather
+ than particles. sample() is called once per physics step and only records
+ a position every stepInterval steps or, if distanceInterval is positive,
+ whenever the particle has moved that far since the last recorded position.
+ */
+class Trail {
+    
+private:
+    std::vector<ofVec3f> m_points;
+    size_t m_head;                  ///< Index of the newest entry.
+    size_t m_size;
+    int m_stepsSinceSample;
+    bool m_sampledLastStep;
+    
+public:
+    typedef ofPtr<Trail> Ref;
+    
+    int stepInterval;               ///< Record every stepInterval-th step.
+    float distanceInterval;         ///< If positive, record every distanceInterval metres instead.
+    
+    Trail(size_t capacity = 128, int stepInterval = 1, float distanceInterval = 0.0f);
+    
+    /// Change the capacity (clears the trail).
+    Trail& setCapacity(size_t capacity);
+    Trail& setStepInterval(int stepInterval);
+    Trail& setDistanceInterval(float distanceInterval);
+    
+    size_t capacity() const { return m_points.size(); }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size==0; }
+    
+    void clear();
+    
+    /// Record a position unconditionally.
+    void push(const ofVec3f& position);
+    
+    /// Record a position if the sampling interval has been reached; returns true if recorded.
+    bool sample(const ofVec3f& position);
+    
+    /// True if the last call to sample() recorded its position.
+    bool sampledLastStep() const { return m_sampledLastStep; }
+    
+    /// The i-th most recent position (0 is the newest).
+    const ofVec3f& operator[](size_t i) const {
+        assert(i < m_size && "Expected trail index within range");
+        size_t n = m_points.size();
+        return m_points[(m_head + n - i) % n];
+    }
+};
+    
+}	// namespace YAMPE
+
+#endif
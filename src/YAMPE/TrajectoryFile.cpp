@@ -0,0 +1,340 @@
+/**
+ @file 		TrajectoryFile.cpp
+ @practical
+ @brief		Chunked columnar file of particle states, streamed and memory mapped.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "TrajectoryFile.h"
+#include "BinaryIO.h"
+
+using namespace YAMPE;
+
+const char* TrajectoryFile::columnNames[TrajectoryFile::COLUMN_COUNT] = {
+    "time", "id", "px", "py", "pz", "vx", "vy", "vz", "potentialEnergy", "kineticEnergy"
+};
+
+namespace {
+
+const char FILE_MAGIC[4] = {'Y', 'T', 'R', '1'};
+const char CHUNK_MAGIC[4] = {'C', 'H', 'N', 'K'};
+
+size_t padded(size_t bytes) {
+    return (bytes + 7) & ~size_t(7);
+}
+
+/**
+ * XOR each word with the one before, group the bytes by their position in
+ * the word and code runs of zero bytes: a token t < 128 is followed by t+1
+ * literal bytes, a token t >= 128 stands for t-126 zero bytes.
+ */
+void pack(const uint32_t* words, size_t n, std::vector<uint8_t>& bytes, std::vector<uint8_t>& out) {
+    out.clear();
+    size_t size = 4*n;
+    size_t i = 0;
+    size_t literal = 0;             // index of the pending literal token, if any
+    bool isLiteral = false;
+    uint32_t previous = 0;
+    // byte i of the shuffled stream is byte i/n of the delta of word i%n
+    bytes.resize(size);
+    for (size_t k=0; k<n; ++k) {
+        uint32_t delta = words[k] ^ previous;
+        previous = words[k];
+        for (int b=0; b<4; ++b) bytes[b*n + k] = uint8_t(delta >> (8*b));
+    }
+    while (i < size) {
+        size_t zeros = 0;
+        while (i + zeros < size && bytes[i + zeros] == 0 && zeros < 129) zeros++;
+        if (zeros >= 2) {
+            out.push_back(uint8_t(zeros + 126));
+            i += zeros;
+            isLiteral = false;
+            continue;
+        }
+        if (!isLiteral || out[literal] == 127) {
+            literal = out.size();
+            out.push_back(0);
+            isLiteral = true;
+        } else {
+            out[literal]++;
+        }
+        out.push_back(bytes[i++]);
+    }
+}
+
+bool unpack(const uint8_t* in, size_t bytes, std::vector<uint8_t>& shuffled, uint32_t* words, size_t n) {
+    size_t size = 4*n;
+    shuffled.resize(size);
+    size_t i = 0;
+    const uint8_t* end = in + bytes;
+    while (in < end) {
+        uint8_t token = *in++;
+        if (token >= 128) {
+            size_t zeros = token - 126;
+            if (i + zeros > size) return false;
+            memset(&shuffled[i], 0, zeros);
+            i += zeros;
+        } else {
+            size_t count = token + 1;
+            if (i + count > size || in + count > end) return false;
+            memcpy(&shuffled[i], in, count);
+            in += count;
+            i += count;
+        }
+    }
+    if (i != size) return false;
+    uint32_t previous = 0;
+    for (size_t k=0; k<n; ++k) {
+        uint32_t delta = uint32_t(shuffled[k]) | uint32_t(shuffled[n + k]) << 8
+                       | uint32_t(shuffled[2*n + k]) << 16 | uint32_t(shuffled[3*n + k]) << 24;
+        previous ^= delta;
+        words[k] = previous;
+    }
+    return true;
+}
+
+}
+
+//--------------------------------------------------------------
+// TrajectoryWriter
+//--------------------------------------------------------------
+
+TrajectoryWriter::TrajectoryWriter() :
+    stalls(0),
+    bytesWritten(0),
+    m_isOpen(false),
+    m_isPacked(false),
+    m_chunkRows(0),
+    m_filling(0),
+    m_count(0),
+    m_rows(0),
+    m_pending(0),
+    m_quit(false)
+{ }
+
+TrajectoryWriter::~TrajectoryWriter() {
+    close();
+}
+
+bool TrajectoryWriter::open(const std::string& fileName, size_t chunkRows, bool isPacked) {
+    assert(chunkRows > 0 && "Expected chunks of at least one row.");
+    close();
+    m_out.open(fileName.c_str(), std::ios::binary);
+    if (!m_out) return false;
+
+    m_out.write(FILE_MAGIC, 4);
+    writeValue(m_out, uint32_t(TrajectoryFile::COLUMN_COUNT));
+    writeValue(m_out, uint32_t(chunkRows));
+    writeValue(m_out, uint32_t(0));
+    bytesWritten = TrajectoryFile::HEADER_SIZE;
+
+    m_isPacked = isPacked;
+    m_chunkRows = chunkRows;
+    for (int i=0; i<2; ++i) m_chunks[i].assign(TrajectoryFile::COLUMN_COUNT * chunkRows, 0.0f);
+    m_filling = 0;
+    m_count = 0;
+    m_rows = 0;
+    m_pending = 0;
+    m_quit = false;
+    stalls = 0;
+    m_thread = std::thread([this]() { write(); });
+    m_isOpen = true;
+    return true;
+}
+
+void TrajectoryWriter::close() {
+    if (!m_isOpen) return;
+    if (m_count > 0) flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    m_out.close();
+    for (int i=0; i<2; ++i) std::vector<float>().swap(m_chunks[i]);
+    m_isOpen = false;
+}
+
+/**
+ * Hand the chunk being filled to the writer thread and start on the other.
+ */
+void TrajectoryWriter::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_pending > 0) {
+        stalls++;
+        m_written.wait(lock, [this] { return m_pending == 0; });
+    }
+    m_pending = m_count;
+    m_filling ^= 1;
+    m_count = 0;
+    lock.unlock();
+    m_wake.notify_one();
+}
+
+void TrajectoryWriter::write() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [this] { return m_pending > 0 || m_quit; });
+        if (m_pending == 0) return;
+
+        // the chunk not being filled is ours until m_pending is cleared
+        size_t rows = m_pending;
+        const std::vector<float>& chunk = m_chunks[m_filling ^ 1];
+        lock.unlock();
+        writeChunk(chunk, rows);
+        lock.lock();
+        m_pending = 0;
+        m_written.notify_one();
+    }
+}
+
+void TrajectoryWriter::writeChunk(const std::vector<float>& chunk, size_t rows) {
+    const uint32_t* columns[TrajectoryFile::COLUMN_COUNT];
+    uint32_t encoding[TrajectoryFile::COLUMN_COUNT];
+    uint32_t bytes[TrajectoryFile::COLUMN_COUNT];
+    uint32_t chunkBytes = 0;
+    for (int c=0; c<TrajectoryFile::COLUMN_COUNT; ++c) {
+        columns[c] = reinterpret_cast<const uint32_t*>(&chunk[c * m_chunkRows]);
+        encoding[c] = TrajectoryFile::RAW;
+        bytes[c] = uint32_t(4*rows);
+        if (m_isPacked) {
+            pack(columns[c], rows, m_shuffled, m_packed[c]);
+            if (m_packed[c].size() < bytes[c]) {
+                encoding[c] = TrajectoryFile::PACKED;
+                bytes[c] = uint32_t(m_packed[c].size());
+            }
+        }
+        chunkBytes += 8 + uint32_t(padded(bytes[c]));
+    }
+
+    m_out.write(CHUNK_MAGIC, 4);
+    writeValue(m_out, uint32_t(rows));
+    writeValue(m_out, chunkBytes);
+    writeValue(m_out, uint32_t(0));
+    const char zeros[8] = {0};
+    for (int c=0; c<TrajectoryFile::COLUMN_COUNT; ++c) {
+        writeValue(m_out, encoding[c]);
+        writeValue(m_out, bytes[c]);
+        const char* data = encoding[c] == TrajectoryFile::PACKED ? reinterpret_cast<const char*>(&m_packed[c][0])
+                                                                   : reinterpret_cast<const char*>(columns[c]);
+        m_out.write(data, bytes[c]);
+        m_out.write(zeros, padded(bytes[c]) - bytes[c]);
+    }
+    m_out.flush();
+    bytesWritten += TrajectoryFile::CHUNK_HEADER_SIZE + chunkBytes;
+}
+
+//--------------------------------------------------------------
+// TrajectoryReader
+//--------------------------------------------------------------
+
+TrajectoryReader::TrajectoryReader() : m_data(NULL), m_size(0), m_rows(0) { }
+
+TrajectoryReader::~TrajectoryReader() {
+    close();
+}
+
+bool TrajectoryReader::open(const std::string& fileName) {
+    close();
+    int file = ::open(fileName.c_str(), O_RDONLY);
+    if (file < 0) return false;
+    struct stat status;
+    if (fstat(file, &status) != 0 || size_t(status.st_size) < TrajectoryFile::HEADER_SIZE) {
+        ::close(file);
+        return false;
+    }
+    m_size = status.st_size;
+    void* data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (data == MAP_FAILED) {
+        m_size = 0;
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(data);
+
+    const uint32_t* header = reinterpret_cast<const uint32_t*>(m_data);
+    if (memcmp(m_data, FILE_MAGIC, 4) != 0 || header[1] != TrajectoryFile::COLUMN_COUNT) {
+        close();
+        return false;
+    }
+
+    // index the chunks, stopping at the first one that is incomplete
+    size_t offset = TrajectoryFile::HEADER_SIZE;
+    while (offset + TrajectoryFile::CHUNK_HEADER_SIZE <= m_size) {
+        const uint32_t* chunkHeader = reinterpret_cast<const uint32_t*>(m_data + offset);
+        if (memcmp(chunkHeader, CHUNK_MAGIC, 4) != 0) break;
+        size_t begin = offset + TrajectoryFile::CHUNK_HEADER_SIZE;
+        size_t end = begin + chunkHeader[2];
+        if (end > m_size) break;
+
+        Chunk chunk;
+        chunk.rows = chunkHeader[1];
+        size_t position = begin;
+        bool isValid = true;
+        for (int c=0; c<TrajectoryFile::COLUMN_COUNT && isValid; ++c) {
+            if (position + 8 > end) {
+                isValid = false;
+                break;
+            }
+            const uint32_t* columnHeader = reinterpret_cast<const uint32_t*>(m_data + position);
+            chunk.encoding[c] = columnHeader[0];
+            chunk.bytes[c] = columnHeader[1];
+            chunk.columns[c] = m_data + position + 8;
+            position += 8 + padded(chunk.bytes[c]);
+            isValid = position <= end
+                && (chunk.encoding[c] == TrajectoryFile::PACKED
+                    || (chunk.encoding[c] == TrajectoryFile::RAW && chunk.bytes[c] == 4*chunk.rows));
+        }
+        if (!isValid) break;
+        m_chunks.push_back(chunk);
+        m_rows += chunk.rows;
+        offset = end;
+    }
+    return true;
+}
+
+void TrajectoryReader::close() {
+    if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+    m_data = NULL;
+    m_size = 0;
+    m_chunks.clear();
+    m_rows = 0;
+}
+
+uint64_t TrajectoryReader::rawSize() const {
+    uint64_t size = TrajectoryFile::HEADER_SIZE;
+    for (size_t i=0; i<m_chunks.size(); ++i) {
+        size += TrajectoryFile::CHUNK_HEADER_SIZE + TrajectoryFile::COLUMN_COUNT * (8 + padded(4*m_chunks[i].rows));
+    }
+    return size;
+}
+
+TrajectoryFile::Encoding TrajectoryReader::encoding(size_t chunk, TrajectoryFile::Column column) const {
+    return TrajectoryFile::Encoding(m_chunks[chunk].encoding[column]);
+}
+
+const uint32_t* TrajectoryReader::words(size_t chunk, TrajectoryFile::Column column) {
+    assert(chunk < m_chunks.size() && "Expected a chunk of the file.");
+    const Chunk& c = m_chunks[chunk];
+    if (c.encoding[column] == TrajectoryFile::RAW) {
+        return reinterpret_cast<const uint32_t*>(c.columns[column]);
+    }
+    m_unpacked.resize(std::max<size_t>(c.rows, 1));
+    if (!unpack(c.columns[column], c.bytes[column], m_shuffled, &m_unpacked[0], c.rows)) {
+        ofLogError("TrajectoryReader") <<"corrupt column " <<TrajectoryFile::columnNames[column] <<" in chunk " <<chunk;
+        std::fill(m_unpacked.begin(), m_unpacked.end(), 0);
+    }
+    return &m_unpacked[0];
+}
+
+const float* TrajectoryReader::column(size_t chunk, TrajectoryFile::Column column) {
+    return reinterpret_cast<const float*>(words(chunk, column));
+}
+
+const int32_t* TrajectoryReader::ids(size_t chunk) {
+    return reinterpret_cast<const int32_t*>(words(chunk, TrajectoryFile::ID));
+}
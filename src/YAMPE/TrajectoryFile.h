@@ -0,0 +1,160 @@
+/**
+ @file 		TrajectoryFile.h
+ @practical
+ @brief		Chunked columnar file of particle states, streamed and memory mapped.
+ */
+
+#ifndef TRAJECTORY_FILE_H
+#define TRAJECTORY_FILE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include "ofMain.h"
+
+namespace YAMPE {
+
+/**
+ A trajectory file holds one row per particle per step (time, particle,
+ position, velocity and energies), split into chunks of rows stored a
+ column at a time:
+
+    header   "YTR1", columns, rows per chunk, 0 (uint32)
+    chunk    "CHNK", rows, bytes of the chunk after this header, 0 (uint32),
+             then per column: encoding, bytes (uint32) and the data padded
+             to 8 bytes, so every column starts 8 byte aligned
+
+ A RAW column is the rows' values as 4-byte little endian words, so a
+ mapped file can be read in place. A PACKED column is each word XORed
+ with the one before, the bytes grouped by position in the word, and runs
+ of zero bytes coded by length; it is used only when it is smaller.
+ */
+namespace TrajectoryFile {
+    enum Column {TIME, ID, PX, PY, PZ, VX, VY, VZ, POTENTIAL_ENERGY, KINETIC_ENERGY, COLUMN_COUNT};
+    enum Encoding {RAW, PACKED};
+    extern const char* columnNames[COLUMN_COUNT];
+    const size_t HEADER_SIZE = 16;
+    const size_t CHUNK_HEADER_SIZE = 16;
+}
+
+/**
+ A trajectory writer streams rows to a trajectory file. Rows are added to
+ one chunk while a background thread encodes and writes the other, so
+ append() only stores ten words; it waits only if a chunk fills before
+ the previous one has been written (see stalls).
+ */
+class TrajectoryWriter {
+
+public:
+    std::atomic<unsigned long> stalls;      ///< appends that waited for the writer thread
+    std::atomic<uint64_t> bytesWritten;
+
+    TrajectoryWriter();
+    ~TrajectoryWriter();
+
+    /// Start a file; false if it cannot be written.
+    bool open(const std::string& fileName, size_t chunkRows = 1 << 16, bool isPacked = false);
+    /// Write the rows so far and close the file.
+    void close();
+    bool isOpen() const { return m_isOpen; }
+    uint64_t rows() const { return m_rows; }
+
+    void append(float time, int id, const ofVec3f& position, const ofVec3f& velocity,
+                float potentialEnergy, float kineticEnergy) {
+        std::vector<float>& c = m_chunks[m_filling];
+        float* row = &c[m_count];
+        size_t n = m_chunkRows;
+        row[TrajectoryFile::TIME*n] = time;
+        int32_t id32 = id;
+        memcpy(&row[TrajectoryFile::ID*n], &id32, sizeof(id32));
+        row[TrajectoryFile::PX*n] = position.x;
+        row[TrajectoryFile::PY*n] = position.y;
+        row[TrajectoryFile::PZ*n] = position.z;
+        row[TrajectoryFile::VX*n] = velocity.x;
+        row[TrajectoryFile::VY*n] = velocity.y;
+        row[TrajectoryFile::VZ*n] = velocity.z;
+        row[TrajectoryFile::POTENTIAL_ENERGY*n] = potentialEnergy;
+        row[TrajectoryFile::KINETIC_ENERGY*n] = kineticEnergy;
+        m_rows++;
+        if (++m_count == m_chunkRows) flush();
+    }
+
+private:
+    std::ofstream m_out;
+    bool m_isOpen;
+    bool m_isPacked;
+    size_t m_chunkRows;
+    std::vector<float> m_chunks[2];     ///< column after column, chunkRows each
+    int m_filling;                      ///< chunk being appended to
+    size_t m_count;                     ///< rows in it
+    uint64_t m_rows;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;     ///< a chunk to write, or close
+    std::condition_variable m_written;  ///< the writer thread is free
+    size_t m_pending;                   ///< rows of the chunk handed over (0 if none)
+    bool m_quit;
+    std::vector<uint8_t> m_shuffled;    ///< scratch of the writer thread
+    std::vector<uint8_t> m_packed[TrajectoryFile::COLUMN_COUNT];
+
+    void flush();
+    void write();
+    void writeChunk(const std::vector<float>& chunk, size_t rows);
+};
+
+/**
+ A trajectory reader maps a trajectory file into memory and gives the
+ columns of each chunk: RAW columns point into the mapping, PACKED ones
+ are unpacked into a buffer of the reader. A chunk cut short (by a crash
+ while recording) ends the file.
+ */
+class TrajectoryReader {
+
+public:
+    TrajectoryReader();
+    ~TrajectoryReader();
+
+    /// Map a file; false if it cannot be read or is not a trajectory file.
+    bool open(const std::string& fileName);
+    void close();
+
+    size_t chunkCount() const { return m_chunks.size(); }
+    size_t chunkRows(size_t chunk) const { return m_chunks[chunk].rows; }
+    uint64_t rows() const { return m_rows; }
+    /// Bytes of the file, and of its columns if they were all RAW.
+    size_t fileSize() const { return m_size; }
+    uint64_t rawSize() const;
+
+    /// Values of a float column of a chunk, valid until the reader unpacks another column.
+    const float* column(size_t chunk, TrajectoryFile::Column column);
+    /// Particle of each row of a chunk, valid as column().
+    const int32_t* ids(size_t chunk);
+    /// Encoding a column of a chunk is stored with.
+    TrajectoryFile::Encoding encoding(size_t chunk, TrajectoryFile::Column column) const;
+
+private:
+    struct Chunk {
+        size_t rows;
+        const uint8_t* columns[TrajectoryFile::COLUMN_COUNT];
+        uint32_t encoding[TrajectoryFile::COLUMN_COUNT];
+        uint32_t bytes[TrajectoryFile::COLUMN_COUNT];
+    };
+
+    const uint8_t* m_data;
+    size_t m_size;
+    std::vector<Chunk> m_chunks;
+    uint64_t m_rows;
+    std::vector<uint32_t> m_unpacked;
+    std::vector<uint8_t> m_shuffled;
+
+    const uint32_t* words(size_t chunk, TrajectoryFile::Column column);
+};
+
+}	// namespace YAMPE
+
+#endif
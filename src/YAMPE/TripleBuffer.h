@@ -0,0 +1,67 @@
+/**
+ @file 		TripleBuffer.h
+ @practical
+ @brief		Lock-free triple buffer for handing state from one thread to another.
+ */
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+namespace YAMPE {
+
+/**
+ A triple buffer passes whole snapshots of state from one writer thread
+ (typically physics) to one reader thread (typically rendering) without
+ either ever waiting for the other.
+
+ The writer fills back() and calls publish(); the reader calls fetch() to
+ pick up the latest published snapshot and reads it through front(). The
+ third buffer sits between them, so the writer can publish again while the
+ reader is still using the previous snapshot. Snapshots the reader is too
+ slow to fetch are skipped, never torn.
+
+ Buffers are reused, so the writer must fill in every field of back()
+ each time (containers keep their capacity and do not reallocate).
+ */
+template <typename T>
+class TripleBuffer {
+
+private:
+    static const int INDEX = 3;             ///< Index bits of m_middle.
+    static const int FRESH = 4;             ///< Set when the middle buffer has not been fetched.
+
+    T m_buffers[3];
+    int m_back;                             ///< Owned by the writer.
+    std::atomic<int> m_middle;              ///< Exchanged between the two.
+    int m_front;                            ///< Owned by the reader.
+
+    TripleBuffer(const TripleBuffer&);
+    TripleBuffer& operator=(const TripleBuffer&);
+
+public:
+    TripleBuffer() : m_back(0), m_middle(1), m_front(2) { }
+
+    /// Buffer being written (writer thread only).
+    T& back() { return m_buffers[m_back]; }
+
+    /// Make back() the latest snapshot and start writing into another buffer.
+    void publish() {
+        m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    /// Take the latest snapshot, if one was published since the last fetch.
+    bool fetch() {
+        if (!(m_middle.load(std::memory_order_acquire) & FRESH)) return false;
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    /// Latest fetched snapshot (reader thread only).
+    const T& front() const { return m_buffers[m_front]; }
+};
+
+}	// namespace YAMPE
+
+#endif
@@ -5,6 +5,9 @@
 void ofApp::setup() {
     
     ofSetLogLevel(OF_LOG_VERBOSE);
+    YAMPE::Profiler::instance().nameThread("main");
+    YAMPE::EventLog::instance().setRecording(1u << YAMPE::EventLog::SPAWN | 1u << YAMPE::EventLog::LAND | 1u << YAMPE::EventLog::HIT);
+    YAMPE::EventLog::instance().start();
     
     // repatable randomness
     ofSeedRandom();
@@ -27,95 +30,154 @@ void ofApp::setup() {
     
     string gameStateLabels[] = {"START", "PLAY", "FIRED", "HIT"};
     gameStates.assign(gameStateLabels, gameStateLabels+4);
-    gameState = START;
     
-    muzzleSpeed = 4.0f;
-    ball.setBodyColor(ofColor(0x666666));
-    reset();
-    balls.reserve(128);
-    for(int i = 0; i < 128; i++) {
-        YAMPE::Particle::Ref partBall(new YAMPE::Particle());
-        partBall->setBodyColor(ofColor(255, i * 2, 0));
-        float num = (128 - i) * 0.00078125;
-        partBall->setRadius(num);
-        balls.push_back(partBall);
-    }
-    int lineLength = 1000;
-    heightLine.reserve(lineLength);
-    velocityLine.reserve(lineLength);
-    energyLine.reserve(lineLength);
-    for(int i = 0; i < lineLength; i++) {
-        heightLine.push_back(0);
-        velocityLine.push_back(0);
-        energyLine.push_back(0);
+    // firing table for the MuzzleSpeed slider range, built on first run
+    string firingTableFile = ofToDataPath("firingTable.bin");
+    if (!firingTable.load(firingTableFile)) {
+        firingTable.build(3.0f, 5.0f, 16, 1024, CannonSimulation::GRAVITY, CannonSimulation::MUZZLE_HEIGHT);
+        firingTable.save(firingTableFile);
     }
     
-    energyError = 0;
+    physics.trail.setCapacity(trailLength);
+    // the target generator gets its own seed, kept in the replay log
+    physics.sim.seed(uint32_t(ofRandom(1.0f, 1e9f)));
+    physics.reset();
+    setRecording(isRecording);
+    physics.fetchSnapshot();
+    physics.startThread();
+    trailSpheres.setup();
+    ballSpheres.setup();
+}
+
+void ofApp::exit() {
+    physics.waitForThread(true);
+    if (dispersionThread.joinable()) dispersionThread.join();
+    physics.recorder.close();
+    physics.trajectories.close();
+    YAMPE::EventLog::instance().stop();
+}
+
+/**
+ * Start logging the session (from its current state) to last.replay, which
+ * the batch runner replays with -replay, or stop.
+ */
+void ofApp::setRecording(bool record) {
+    physics.lock();
+    if (record) {
+        isRecording = physics.recorder.open(ofToDataPath("last.replay"), physics.sim, physics.clock.step);
+    } else {
+        physics.recorder.close();
+        isRecording = false;
+    }
+    physics.unlock();
+}
+
+/**
+ * Start streaming the state of every ball in flight, every step, to
+ * trajectories.ytr (read it with batch -trajectory), or stop.
+ */
+void ofApp::setTrajectoryRecording(bool record) {
+    physics.lock();
+    if (record) {
+        isRecordingTrajectories = physics.trajectories.open(ofToDataPath("trajectories.ytr"), 1 << 16, true);
+    } else {
+        physics.trajectories.close();
+        isRecordingTrajectories = false;
+    }
+    physics.unlock();
 }
 
 void ofApp::reset() {
+    physics.lock();
+    physics.reset();
+    physics.unlock();
+}
 
-    t = 0.0f;
+void ofApp::update() {
+    YAMPE_PROFILE_SCOPE("app/update");
     
-    target.set(ofRandom(1) * 15.0f - 7.5f, 0, ofRandom(1) * 15.0f - 7.5f);
-    ball.force = ofVec3f();
-    ball.acceleration = ofVec3f();
-    ball.velocity = ofVec3f();
-    ball.position = ofVec3f();
+    // the physics steps on its own thread: pick up its latest state for this frame
+    physics.fetchSnapshot();
+    
+    if (isPreviewVisible) {
+        physics.lock();
+        bool isChanged = preview.update(physics.sim, physics.clock.step);
+        physics.unlock();
+        if (isChanged) buildPreview();
+    }
+    
+    if (isHeatmapStale && !isDispersionRunning) {
+        buildHeatmap();
+        isHeatmapStale = false;
+    }
 }
 
-void ofApp::update() {
+/**
+ * Study the current aim in the background: the results and heatmap are
+ * picked up by update() once it finishes.
+ */
+void ofApp::runDispersion() {
+    if (isDispersionRunning) return;
+    if (dispersionThread.joinable()) dispersionThread.join();
+    
+    physics.lock();
+    dispersion.aimFrom(physics.sim);
+    physics.unlock();
+    
+    long shots = long(pow(10.0, dispersionShotsIndex + 3));
+    isDispersionRunning = true;
+    isHeatmapStale = true;
+    dispersionThread = std::thread([this, shots]() {
+        dispersion.run(shots, &dispersionScheduler);
+        isDispersionRunning = false;
+    });
+}
 
-    float dt = ofClamp(ofGetLastFrameTime(), 0.0, 0.02);
-    if (!isRunning) return;
-    t += dt;
-
-    if(dt > 0) {
-        if(ball.position.y > 0) {
-            //Position over zero means that the ball is still in the air.
-            ball.acceleration = ofVec3f(0, -0.981f, 0);
-        } else {
-            //Position below or equal zero means that the ball has hit the floor.
-            if(ball.position.y < 0) {
-                gameState = HIT;
+/**
+ * One quad per occupied heatmap cell, from faint yellow to solid red with
+ * the share of the busiest cell.
+ */
+void ofApp::buildHeatmap() {
+    heatmapMesh.clear();
+    heatmapMesh.setMode(OF_PRIMITIVE_TRIANGLES);
+    if (dispersion.heatmapMaximum == 0) return;
+    
+    float half = 0.5f*dispersion.cellSize();
+    for (int row = 0; row < dispersion.heatmapSize; row++) {
+        for (int column = 0; column < dispersion.heatmapSize; column++) {
+            int count = dispersion.heatmap[row*dispersion.heatmapSize + column];
+            if (count == 0) continue;
+            float w = sqrt(float(count) / dispersion.heatmapMaximum);
+            ofFloatColor color(1.0f, 1.0f - w, 0.0f, 0.25f + 0.75f*w);
+            ofVec3f centre = dispersion.cellCentre(column, row);
+            ofVec3f corners[4] = {centre + ofVec3f(-half, 0, -half), centre + ofVec3f(half, 0, -half),
+                                  centre + ofVec3f(half, 0, half), centre + ofVec3f(-half, 0, half)};
+            int indices[6] = {0, 1, 2, 0, 2, 3};
+            for (int k = 0; k < 6; k++) {
+                heatmapMesh.addVertex(corners[indices[k]]);
+                heatmapMesh.addColor(color);
             }
-            ball.velocity = ofVec3f(0, 0, 0);
-            ball.position.y = 0;
-        }
-        // update the track "balls"
-        for(int i = balls.size() - 2; i >= 0; i--) {
-            balls[i + 1]->position.x = balls[i]->position.x;
-            balls[i + 1]->position.y = balls[i]->position.y;
-            balls[i + 1]->position.z = balls[i]->position.z;
         }
-        // set the first item of the "track" balls to the current position.
-        balls[0]->position.x = ball.position.x;
-        balls[0]->position.y = ball.position.y;
-        balls[0]->position.z = ball.position.z;
-        ball.integrate(dt);
-        
-        ball.potentialEnergy = 9.81f * ball.position.y * ball.mass();
-        ball.kineticEnergy = 0.5f * ball.velocity.lengthSquared() * ball.mass();
-        ball.errorEnergy = abs(ball.potentialEnergy - ball.kineticEnergy);
-        
-        /**
-         * Move all the historic line points one position to the left.
-         */
-        velocityLine[0] = 0.0f;
-        energyLine[0] = 0.0f;
-        heightLine[0] = 0.0f;
-        for(int i = 0; i < heightLine.size() - 1; i++) {
-            heightLine[i] = heightLine[i + 1];
-            velocityLine[i] = velocityLine[i + 1];
-            energyLine[i] = energyLine[i + 1];
-        }
-        heightLine[heightLine.size() - 1] = ball.position.y;
-        velocityLine[velocityLine.size() - 1] = ball.position.x;
-        energyLine[energyLine.size() - 1] = ball.errorEnergy;
+    }
+}
+
+/**
+ * The preview arc as a line strip, green if it ends in the target.
+ */
+void ofApp::buildPreview() {
+    previewMesh.clear();
+    previewMesh.setMode(OF_PRIMITIVE_LINE_STRIP);
+    ofFloatColor color = preview.hitsTarget ? ofFloatColor(0.0f, 1.0f, 0.0f) : ofFloatColor(1.0f, 1.0f, 1.0f);
+    for (size_t i = 0; i < preview.points.size(); i++) {
+        previewMesh.addVertex(preview.points[i]);
+        previewMesh.addColor(color);
     }
 }
 
 void ofApp::draw() {
+    YAMPE_PROFILE_SCOPE("app/draw");
+    const CannonSnapshot& snapshot = physics.snapshot();
+    
     ofEnableDepthTest();
     ofBackgroundGradient(ofColor(128), ofColor(0), OF_GRADIENT_BAR);
     
@@ -142,24 +204,75 @@ void ofApp::draw() {
     
     ofPushMatrix();
     ofTranslate(0, 0.5, 0);
-    float rightDirection = direction + 90.0f;
+    float rightDirection = snapshot.direction + 90.0f;
     ofRotateY(rightDirection);
-    float rightElevation = 90.0f - elevation;
+    float rightElevation = 90.0f - snapshot.elevation;
     ofRotateX(rightElevation);
     ofTranslate(0, -0.5, 0);
     ofSetColor(255, 128, 0);
     ofDrawCylinder(0, 1.0, 0, 0.15, 1);
     ofPopMatrix();
+    //predicted arc and impact of the next shot
+    if (isPreviewVisible && previewMesh.getNumVertices() > 0) {
+        previewMesh.draw();
+        if (preview.hasLanded) {
+            ofSetColor(preview.hitsTarget ? ofColor(0, 255, 0) : ofColor(255));
+            ofDrawSphere(preview.impact, 0.08f);
+        }
+    }
+    //impacts of the last dispersion study, just above the ground
+    if (isHeatmapVisible && heatmapMesh.getNumVertices() > 0) {
+        ofPushMatrix();
+        ofPushStyle();
+        ofEnableAlphaBlending();
+        ofTranslate(0, 0.01f, 0);
+        heatmapMesh.draw();
+        ofPopStyle();
+        ofPopMatrix();
+    }
     //reset color.
     ofSetColor(0, 0, 0);
-    ofDrawBox(target.x, 0, target.z, 1, 0.1, 1);
-    //this draws the track of the balls
-    for(int i = 0; i < balls.size(); i++) {
-        balls[i]->draw();
+    ofDrawBox(snapshot.target.x, 0, snapshot.target.z, CannonSimulation::TARGET_SIZE, CannonSimulation::TARGET_HEIGHT, CannonSimulation::TARGET_SIZE);
+    // positions are drawn interpolated between the last two physics steps
+    float alpha = snapshot.alphaAt(SimulationThread::now());
+    if (isLevelOfDetailEnabled) {
+        trailSpheres.setView(easyCam);
+        ballSpheres.setView(easyCam);
+    } else {
+        trailSpheres.clearView();
+        ballSpheres.clearView();
     }
     
-    //this draws the current ball
-    ball.draw();
+    //this draws the track of the balls, shrinking and fading from red to
+    //yellow along its length. When the track is sampled every step the
+    //previous state of each track ball is held by the next one along.
+    {
+        YAMPE_PROFILE_SCOPE("draw/trail");
+        const vector<ofVec3f>& trail = snapshot.trail;
+        trailSpheres.clear();
+        for(size_t i = 0; i < trail.size(); i++) {
+            float age = float(i) / snapshot.trailCapacity;
+            ofVec3f position = trail[i];
+            if (snapshot.isTrailInterpolated && i + 1 < trail.size()) {
+                position = trail[i + 1].getInterpolated(position, alpha);
+            }
+            trailSpheres.add(position, 0.1f * (1.0f - age), ofColor(255, 256 * age, 0));
+        }
+        trailSpheres.draw();
+    }
+    
+    //this draws every ball in flight, and the last ball where it landed
+    {
+        YAMPE_PROFILE_SCOPE("draw/balls");
+        ballSpheres.clear();
+        for(size_t i = 0; i < snapshot.current.size(); i++) {
+            ballSpheres.add(snapshot.previous[i].getInterpolated(snapshot.current[i], alpha), snapshot.radius[i], snapshot.color[i]);
+        }
+        if (snapshot.gameState != CannonSimulation::FIRED) {
+            ballSpheres.add(snapshot.ball);
+        }
+        ballSpheres.draw();
+    }
     
     ofPopStyle();
 
@@ -167,6 +280,7 @@ void ofApp::draw() {
     ofPopStyle();
 
     // draw gui elements
+    YAMPE_PROFILE_SCOPE("draw/gui");
     gui.begin();
     drawAppMenuBar();
     drawMainWindow();
@@ -225,6 +339,10 @@ void ofApp::drawAppMenuBar() {
 
 void ofApp::drawMainWindow() {
     
+    // controls change the simulation, so they hold the physics thread off
+    // between its steps; everything displayed comes from the snapshot
+    CannonSimulation& sim = physics.sim;
+    const CannonSnapshot& snapshot = physics.snapshot();
 
     ImGui::SetNextWindowSize(ImVec2(400,400), ImGuiSetCond_FirstUseEver);
     if (ImGui::Begin("Main")) {
@@ -242,40 +360,179 @@ void ofApp::drawMainWindow() {
             if (ImGui::SliderFloat("Camera Height Ratio", &cameraHeightRatio, 0.0f, 1.0f))
                 cameraHeightRatioChanged(cameraHeightRatio);
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-            ImGui::SliderFloat("MuzzleSpeed", &muzzleSpeed, 3.0f, 5.0f, "%2.2f (m/s)");
-            ImGui::SliderFloat("Elevation", &elevation, 0.0f, 90.0f, "%3.0f (deg)", 1);
-            ImGui::SliderFloat("Direction", &direction, 0.0f, 360.0f, "%3.0f (deg)", 1);
-            if(ImGui::Button("Aim")) aim();
+            physics.lock();
+            ImGui::SliderFloat("MuzzleSpeed", &sim.muzzleSpeed, 3.0f, 5.0f, "%2.2f (m/s)");
+            ImGui::SliderFloat("Elevation", &sim.elevation, 0.0f, 90.0f, "%3.0f (deg)", 1);
+            ImGui::SliderFloat("Direction", &sim.direction, 0.0f, 360.0f, "%3.0f (deg)", 1);
+            if (ImGui::Checkbox("Use firing table", &useFiringTable)) {
+                sim.firingTable = useFiringTable ? &firingTable : NULL;
+            }
+            ImGui::SameLine();
+            ImGui::Text("(max error %4.2f deg)", firingTable.maxError());
+            if(ImGui::Button("Aim")) sim.aim();
             ImGui::SameLine();
-            if(ImGui::Button("fire")) fire();
+            if(ImGui::Button("fire")) sim.fire();
+            physics.unlock();
+            ImGui::Checkbox("Preview", &isPreviewVisible);
+            if (isPreviewVisible && preview.hasLanded) {
+                ImGui::SameLine();
+                ImGui::Text("%s at (%5.2f, %5.2f) after %4.2f s", preview.hitsTarget ? "hits" : "lands",
+                            preview.impact.x, preview.impact.z, preview.flightTime);
+            }
+        }
+        
+        if (ImGui::CollapsingHeader("Physics Clock")) {
+            physics.lock();
+            stepMilliseconds = 1000.0f*physics.clock.step;  // the drift alarm may have shrunk it
+            if (ImGui::SliderFloat("Step", &stepMilliseconds, 1.0f, 50.0f, "%4.1f (ms)")) {
+                physics.clock.setStep(stepMilliseconds/1000.0f);
+            }
+            ImGui::SliderInt("Max Substeps", &physics.clock.maxSubsteps, 1, 64);
+            const char* integrators[] = {"Euler", "Velocity Verlet", "RK4", "Dormand-Prince RK45"};
+            int integratorType = sim.integratorType;
+            if (ImGui::Combo("Integrator", &integratorType, integrators, 4)) {
+                sim.setIntegrator(integratorType);
+            }
+            if (ImGui::SliderInt("Threads", &physicsThreads, 1, std::max(1u, std::thread::hardware_concurrency()))) {
+                physics.scheduler.setThreadCount(physicsThreads);
+            }
+            ImGui::SliderFloat("Drift Alarm", &physics.driftThreshold, 0.001f, 0.1f, "%5.3f");
+            ImGui::Checkbox("Shrink Step on Drift", &physics.isStepShrinking);
+            bool isDragEnabled = sim.drag->enabled;
+            physics.unlock();
+            ImGui::Text("Energy drift:  %6.3f%% (%lu step shrinks)%s", 100.0f*physics.driftLine.latest(),
+                        physics.stepShrinks.load(), isDragEnabled ? ", drag on" : "");
+            if (physics.isDriftAlarm) {
+                ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Energy drift above %5.3f", physics.driftThreshold);
+                ImGui::SameLine();
+                if (ImGui::Button("Clear")) physics.isDriftAlarm = false;
+            }
+            ImGui::Text("%s", snapshot.integrator.c_str());
+            ImGui::Text("Stolen chunks: %lu", physics.scheduler.steals.load());
+            ImGui::Text("Physics rate:  %5.0f Hz", 1.0f/snapshot.step);
+            ImGui::Text("Dropped time:  %5.2f s", snapshot.droppedTime);
+        }
+        
+        if (ImGui::CollapsingHeader("Dispersion")) {
+            if (isDispersionRunning) {
+                ImGui::Text("Firing %ld shots on %d threads ...", long(pow(10.0, dispersionShotsIndex + 3)),
+                            dispersionScheduler.threadCount());
+            } else {
+                ImGui::SliderFloat("Speed spread", &dispersion.muzzleSpeedSigma, 0.0f, 0.5f, "%4.3f (m/s)");
+                ImGui::SliderFloat("Elevation spread", &dispersion.elevationSigma, 0.0f, 5.0f, "%4.2f (deg)");
+                ImGui::SliderFloat("Direction spread", &dispersion.directionSigma, 0.0f, 5.0f, "%4.2f (deg)");
+                ImGui::SliderFloat("Wind spread", &dispersion.windSigma, 0.0f, 2.0f, "%4.2f (m/s)");
+                const char* shotCounts[] = {"1k", "10k", "100k", "1M"};
+                ImGui::Combo("Shots", &dispersionShotsIndex, shotCounts, 4);
+                if (ImGui::Button("Study current aim")) runDispersion();
+                if (dispersion.shots > 0) {
+                    ImGui::Text("Hit rate:      %5.1f %% of %ld shots (%.2f s)", 100.0f*dispersion.hitRate(),
+                                dispersion.shots, dispersion.seconds);
+                    ImGui::Text("CEP:           %5.3f m (%5.3f m about the mean impact)",
+                                dispersion.cep, dispersion.cepAboutMean);
+                    ImGui::Text("Mean impact:   {%5.2f, %5.2f}", dispersion.meanImpact.x, dispersion.meanImpact.z);
+                }
+            }
+            ImGui::Checkbox("Show heatmap", &isHeatmapVisible);
+        }
+        
+        if (ImGui::CollapsingHeader("Replay")) {
+            bool record = isRecording;
+            if (ImGui::Checkbox("Record session", &record)) setRecording(record);
+            if (isRecording) {
+                ImGui::Text("%s: %.1f KB", ofFilePath::getFileName(physics.recorder.fileName()).c_str(),
+                            physics.recorder.bytesWritten() / 1024.0f);
+            }
+            bool recordTrajectories = isRecordingTrajectories;
+            if (ImGui::Checkbox("Record trajectories", &recordTrajectories)) setTrajectoryRecording(recordTrajectories);
+            if (isRecordingTrajectories) {
+                ImGui::Text("trajectories.ytr: %.1f MB, %lu stalls", physics.trajectories.bytesWritten / 1048576.0f,
+                            physics.trajectories.stalls.load());
+            }
+        }
+        
+        if (ImGui::CollapsingHeader("Forces")) {
+            physics.lock();
+            for(size_t i = 0; i < sim.forces.size(); i++) {
+                const YAMPE::ForceRegistry::Entry& entry = sim.forces[i];
+                ImGui::Checkbox(entry.generator->label().c_str(), &entry.generator->enabled);
+                if (i < snapshot.forceSeconds.size()) {
+                    ImGui::SameLine();
+                    ImGui::Text("%7.1f us (avg %7.1f us)", 1e6f * snapshot.forceSeconds[i],
+                                1e6f * snapshot.forceAverageSeconds[i]);
+                }
+            }
+            ImGui::SliderFloat("Linear drag", &sim.drag->k1, 0.0f, 0.5f, "%4.3f");
+            ImGui::SliderFloat("Quadratic drag", &sim.drag->k2, 0.0f, 0.1f, "%4.3f");
+            ImGui::InputFloat3("Wind", &sim.drag->wind.x);
+            physics.unlock();
+        }
+        
+        if (ImGui::CollapsingHeader("Track")) {
+            YAMPE::Trail& trail = physics.trail;
+            physics.lock();
+            if (ImGui::SliderInt("Length", &trailLength, 1, 4096)) {
+                trail.setCapacity(trailLength);
+            }
+            ImGui::SliderInt("Every n steps", &trail.stepInterval, 1, 32);
+            ImGui::SliderFloat("Every d metres", &trail.distanceInterval, 0.0f, 1.0f, "%4.2f (m)");
+            physics.unlock();
+            if (ImGui::Checkbox("Instanced drawing", &trailSpheres.useInstancing)) {
+                ballSpheres.useInstancing = trailSpheres.useInstancing;
+            }
+            ImGui::Checkbox("Cull and level of detail", &isLevelOfDetailEnabled);
+            const YAMPE::SphereBatch* batches[2] = {&trailSpheres, &ballSpheres};
+            const char* batchNames[2] = {"Track", "Balls"};
+            for (int b = 0; b < 2; b++) {
+                const YAMPE::SphereBatch::Statistics& s = batches[b]->statistics();
+                ImGui::Text("%s: %d high, %d medium, %d low, %d points, %d culled", batchNames[b],
+                            s.drawn[YAMPE::SphereBatch::HIGH], s.drawn[YAMPE::SphereBatch::MEDIUM],
+                            s.drawn[YAMPE::SphereBatch::LOW], s.drawn[YAMPE::SphereBatch::POINT], s.culled);
+            }
         }
         
 
         if(ImGui::Button("Reset")) {reset();}
         ImGui::SameLine();
-        if(ImGui::Button(isRunning?"Stop":" Go ")) {isRunning = !isRunning;}
+        bool isRunning = physics.isRunning;
+        if(ImGui::Button(isRunning?"Stop":" Go ")) {physics.isRunning = !isRunning;}
         ImGui::SameLine();
-        ImGui::Text("   Time = %8.1f", t);
+        ImGui::Text("   Time = %8.1f", snapshot.t);
         if(ImGui::Button("Quit")) {quit();}
         
         if (ImGui::CollapsingHeader("Numerical Output")) {
             // Display some useful info
-            ImGui::Text("Elevation:     % 5.2f", elevation);
-            ImGui::Text("Direction:     % 5.2f", direction);
-            ImGui::Text("Game State:    %5s", gameStates[gameState].c_str());
+            const YAMPE::Particle& ball = snapshot.ball;
+            ImGui::Text("Elevation:     % 5.2f", snapshot.elevation);
+            ImGui::Text("Direction:     % 5.2f", snapshot.direction);
+            ImGui::Text("Game State:    %5s", gameStates[snapshot.gameState].c_str());
+            ImGui::Text("Balls in flight: %d / %d", int(snapshot.current.size()), snapshot.capacity);
+            ImGui::Text("Target hits:   %d / %d shots", snapshot.targetHits, snapshot.shotsFired);
+            ImGui::Text("Contacts:      %d (%d pair tests)", snapshot.contacts, snapshot.pairTests);
             ImGui::Text("Ball Position: {%5.2f, %5.2f, %5.2f}", ball.position.x, ball.position.y, ball.position.z);
             ImGui::Text("Ball Velocity: {%5.2f, %5.2f, %5.2f}", ball.velocity.x, ball.velocity.y, ball.velocity.z);
             ImGui::Text("Ball Energy:\n"
                         "Potential: %5.2f J\n"
                         "Kinetic: %5.2f J\n "
-                        "Total: %5.2f J", ball.potentialEnergy, ball.kineticEnergy, ball.potentialEnergy + ball.kineticEnergy);
-            ImGui::Text("Distance to target: %5.2f", ball.position.distance(target));
+                        "Total: %5.2f J\n"
+                        "Drift: %7.4f J", ball.potentialEnergy, ball.kineticEnergy, ball.potentialEnergy + ball.kineticEnergy,
+                        ball.errorEnergy);
+            ImGui::Text("Distance to target: %5.2f", ball.position.distance(snapshot.target));
+            if (!snapshot.isTargetInRange) {
+                ImGui::Text("Target out of range (max %5.2f m)", snapshot.maximumRange);
+            }
         }
         
         if (ImGui::CollapsingHeader("Graphical Output")) {
-            ImGui::PlotHistogram("Height (y)", &heightLine[0], heightLine.size());
-            ImGui::PlotHistogram("Horizontal (x)", &velocityLine[0], velocityLine.size());
-            ImGui::PlotHistogram("Energy Error", &energyLine[0], energyLine.size());
+            // plot the channels in place (no copy), oldest sample first
+            YAMPE::TelemetryChannel::View height = physics.heightLine.view();
+            YAMPE::TelemetryChannel::View horizontal = physics.velocityLine.view();
+            YAMPE::TelemetryChannel::View energy = physics.energyLine.view();
+            ImGui::PlotHistogram("Height (y)", &YAMPE::TelemetryChannel::View::valueAt, &height, height.count);
+            ImGui::PlotHistogram("Horizontal (x)", &YAMPE::TelemetryChannel::View::valueAt, &horizontal, horizontal.count);
+            YAMPE::TelemetryChannel::View drift = physics.driftLine.view();
+            ImGui::PlotHistogram("Energy Error", &YAMPE::TelemetryChannel::View::valueAt, &energy, energy.count);
+            ImGui::PlotLines("Energy Drift", &YAMPE::TelemetryChannel::View::valueAt, &drift, drift.count);
         }
     }
     // store window size so that camera can ignore mouse clicks
@@ -288,8 +545,89 @@ void ofApp::drawMainWindow() {
 
 
 void ofApp::drawLoggingWindow() {
-    ImGui::SetNextWindowSize(ImVec2(200,300), ImGuiSetCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(420,300), ImGuiSetCond_FirstUseEver);
     if (ImGui::Begin("Logging")) {
+        if (ImGui::CollapsingHeader("Profile")) {
+            YAMPE::Profiler& profiler = YAMPE::Profiler::instance();
+        
+            bool isProfiling = profiler.isEnabled;
+            if (ImGui::Checkbox("Profile", &isProfiling)) profiler.isEnabled = isProfiling;
+            ImGui::SameLine();
+            if (!profiler.isCapturing()) {
+                if (ImGui::Button("Capture trace")) profiler.startCapture();
+            } else if (ImGui::Button("Stop and save")) {
+                traceFile = ofToDataPath("trace.json");
+                if (!profiler.stopCapture(traceFile)) traceFile = "(could not write trace.json)";
+            }
+            if (!traceFile.empty()) {
+                ImGui::Text("%s", traceFile.c_str());
+                if (profiler.droppedEvents() > 0) ImGui::Text("%lu events dropped", profiler.droppedEvents());
+            }
+        
+            // timings over the last ProfileSite::WINDOW runs of each scope (ms)
+            ImGui::Separator();
+            ImGui::Columns(6, "profile");
+            ImGui::Text("Scope"); ImGui::NextColumn();
+            ImGui::Text("Last"); ImGui::NextColumn();
+            ImGui::Text("Min"); ImGui::NextColumn();
+            ImGui::Text("Avg"); ImGui::NextColumn();
+            ImGui::Text("p99"); ImGui::NextColumn();
+            ImGui::Text("Calls"); ImGui::NextColumn();
+            ImGui::Separator();
+            std::vector<YAMPE::ProfileSite*> sites = profiler.sites();
+            for (size_t i = 0; i < sites.size(); i++) {
+                YAMPE::ProfileSite::Statistics s = sites[i]->statistics();
+                ImGui::Text("%s", sites[i]->name.c_str()); ImGui::NextColumn();
+                ImGui::Text("%.3f", 1e3f*s.last); ImGui::NextColumn();
+                ImGui::Text("%.3f", 1e3f*s.min); ImGui::NextColumn();
+                ImGui::Text("%.3f", 1e3f*s.average); ImGui::NextColumn();
+                ImGui::Text("%.3f", 1e3f*s.p99); ImGui::NextColumn();
+                ImGui::Text("%lu", s.count); ImGui::NextColumn();
+            }
+            ImGui::Columns(1);
+        }
+        
+        if (ImGui::CollapsingHeader("Events")) {
+            YAMPE::EventLog& log = YAMPE::EventLog::instance();
+            
+            unsigned recording = log.recording();
+            ImGui::Text("Record");
+            ImGui::PushID("record");
+            for (int type = 0; type < YAMPE::EventLog::TYPE_COUNT; type++) {
+                ImGui::SameLine();
+                ImGui::CheckboxFlags(YAMPE::EventLog::typeNames[type], &recording, 1u << type);
+            }
+            ImGui::PopID();
+            log.setRecording(recording);
+            ImGui::Text("Show  ");
+            ImGui::PushID("show");
+            for (int type = 0; type < YAMPE::EventLog::TYPE_COUNT; type++) {
+                ImGui::SameLine();
+                ImGui::CheckboxFlags(YAMPE::EventLog::typeNames[type], &eventView.types, 1u << type);
+            }
+            ImGui::PopID();
+            ImGui::InputInt("Ball (-1 for all)", &eventView.id);
+            ImGui::Checkbox("Follow", &isFollowingEvents);
+            
+            size_t shown = eventView.size();
+            eventView.update(log);
+            ImGui::Text("%llu events, %lu dropped, %d shown", (unsigned long long)log.written(),
+                        log.droppedRecords(), int(eventView.size()));
+            
+            // only the rows in view are copied out of the log and formatted
+            ImGui::BeginChild("events", ImVec2(0, 240), true);
+            char line[160];
+            ImGuiListClipper clipper(int(eventView.size()), ImGui::GetTextLineHeightWithSpacing());
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                YAMPE::LogRecord record;
+                if (!eventView.row(log, i, record)) continue;
+                YAMPE::EventLog::format(record, line, sizeof(line));
+                ImGui::TextUnformatted(line);
+            }
+            clipper.End();
+            if (isFollowingEvents && eventView.size() != shown) ImGui::SetScrollHere(1.0f);
+            ImGui::EndChild();
+        }
     }
     // store window size so that camera can ignore mouse clicks
     loggingWindowRectangle.setPosition(ImGui::GetWindowPos().x,ImGui::GetWindowPos().y);
@@ -335,10 +673,14 @@ void ofApp::keyPressed(int key) {
             break;
 */
         case 'a':
-            aim();
+            physics.lock();
+            physics.sim.aim();
+            physics.unlock();
             break;
         case 's':
-            fire();
+            physics.lock();
+            physics.sim.fire();
+            physics.unlock();
             break;
         case 'r':
             reset();
@@ -392,83 +734,6 @@ void ofApp::quit() {
     ofExit();
 }
 
-void ofApp::aim() {
-    gameState = PLAY;
-    
-    ofVec3f direct = target.getNormalized();
-    //with the atan2 function the angle can be gathered by the vector data.
-    float angle = ofRadToDeg(atan2(direct.x,direct.z)) - 90.0f;
-    //correct angles below zero.
-    while (angle < 0) {
-        angle += 360;
-    }
-    direction = angle;
-    float distance = target.lengthSquared();
-    int calcAngle = calculateElevation(distance);
-    elevation = calcAngle;
-}
-
-/**
- * The range function estimates the distance of the ball with the given angle.
- * @param e this is the given angle in degrees.
- */
-float ofApp::range(float e) {
-    float ux = muzzleSpeed * cos(ofDegToRad(e));
-    float uy = muzzleSpeed * sin(ofDegToRad(e));
-    float h = 0.5;
-    float g = 0.981;
-    
-    float calcDistance = ( ux / g ) * ( uy + sqrt ( uy*uy + 2*g*h ) ) ;
-    calcDistance *= calcDistance;
-    return calcDistance;
-}
-/**
- * This function tries to get the right angle with trying by trying the 
- * {@code range(e)} function.
- */
-float ofApp::calculateElevation(float targetDistance) {
-    float xMin(0.0f), fxMin(targetDistance - range(xMin));
-    float xMax(90.0f), fxMax(targetDistance - range(xMax));
-    
-    while(xMax - xMin > 0.1e-3) {
-        float x = 0.5 * (xMin + xMax);
-        float fx = targetDistance - range(x);
-        
-        if(fxMin * fx < 0) {
-            xMax = x;
-            fxMax = fx;
-        } else {
-            xMin = x;
-            fxMin = fx;
-        }
-    }
-    return 0.5 * (xMin + xMax);
-}
-
-/**
- * The fire function fires the cannon and sets the game state accordingly.
- */
-void ofApp::fire() {
-    ball.position = ofVec3f(0, 0.5, 0);
-    ball.velocity = ofVec3f(0, 0, 0);
-    ball.acceleration = ofVec3f(0, 0, 0);
-    
-    float rightDirection = direction + 90.0f;
-    float rightElevation = 90.0f - elevation;
-    
-    float cosElevation = cos(ofDegToRad(rightElevation));
-    float sinElevation = sin(ofDegToRad(rightElevation));
-    float sinDirection = sin(ofDegToRad(rightDirection));
-    float cosDirection = cos(ofDegToRad(rightDirection));
-    
-    float dirY = cosElevation * muzzleSpeed;
-    float dirX = sinDirection * sinElevation * muzzleSpeed;
-    float dirZ = cosDirection * sinElevation * muzzleSpeed;
-    
-    ball.setVelocity(ofVec3f(dirX, dirY, dirZ));
-    
-    gameState = FIRED;
-}
 void ofApp::keyReleased(int key) {}
 void ofApp::mouseMoved(int x, int y ) {}
 void ofApp::mouseDragged(int x, int y, int button) {}
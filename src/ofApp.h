@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
 #include <vector>
 
 #include "ofMain.h"
@@ -7,6 +9,13 @@
 
 #include "ofxXmlSettings.h"
 #include "YAMPE/Particle.h"
+#include "YAMPE/Profiler.h"
+#include "YAMPE/EventLog.h"
+#include "YAMPE/SphereBatch.h"
+#include "Cannon/CannonSimulation.h"
+#include "Cannon/SimulationThread.h"
+#include "Cannon/DispersionStudy.h"
+#include "Cannon/TrajectoryPreview.h"
 
 class ofApp : public ofBaseApp {
     
@@ -14,6 +23,7 @@ public:
     void setup();
     void update();
     void draw();
+    void exit();
     
     void keyPressed(int key);
     void keyReleased(int key);
@@ -43,12 +53,19 @@ public:
     void drawAppMenuBar();
     void drawMainWindow();
     void drawLoggingWindow();
+    string traceFile;                       ///< last trace captured, for display
+    YAMPE::EventLogView eventView;          ///< filtered rows of the event log
+    bool isFollowingEvents = true;          ///< keep the newest event in view
     
     // simimulation (generic)
     void reset();
     void quit();
-    float t = 0.0f;
-    bool isRunning = true;
+    float stepMilliseconds = 1000.0f/120.0f;
+    int physicsThreads = 1;
+    bool isRecording = true;                ///< log the session to last.replay
+    void setRecording(bool record);
+    bool isRecordingTrajectories = false;   ///< stream every ball every step to trajectories.ytr
+    void setTrajectoryRecording(bool record);
     
     ofParameter<bool> isAxisVisible = true;
     ofParameter<bool> isXGridVisible = false;
@@ -59,29 +76,38 @@ public:
     ofParameter<std::string> position;
 
     // simulation (specific stuff)
-    // cannon attributes
-    float elevation;                        ///< rotation about the y-axis
-    float direction;                        ///< rotation about the z-axis
-    float muzzleSpeed;                      ///< magnitude of initial velocity
-
-    // game state
-    enum GameState {START, PLAY, FIRED, HIT};
-    int gameState;
+    // cannon, ball and target --- see CannonSimulation, stepped on its own
+    // thread; draw from physics.snapshot(), lock physics to change it
+    SimulationThread physics;
+    FiringTable firingTable;                ///< optional lookup table for aim()
+    bool useFiringTable = false;
     vector <string> gameStates;
     
-    // cannon ball --- TODO we could have an pool of balls instead
-    YAMPE::Particle ball;
-    vector<YAMPE::Particle::Ref> balls;
-    ofVec3f target;         //< target - note y coordinate is zero
-    float energyError;
+    // Monte Carlo study of the current aim, run on its own thread; the
+    // study is only touched here while isDispersionRunning is false
+    DispersionStudy dispersion;
+    YAMPE::TaskScheduler dispersionScheduler;   ///< one thread per core
+    std::thread dispersionThread;
+    std::atomic<bool> isDispersionRunning{false};
+    int dispersionShotsIndex = 2;           ///< 10^(index+3) shots
+    bool isHeatmapVisible = true;
+    bool isHeatmapStale = false;
+    ofMesh heatmapMesh;                     ///< impacts of the last study, on the ground
+    void runDispersion();
+    void buildHeatmap();
+    
+    // predicted arc of the next shot, simulated again only when the aim,
+    // target or forces change
+    TrajectoryPreview preview;
+    bool isPreviewVisible = true;
+    ofMesh previewMesh;
+    void buildPreview();
     
-    void aim();
-    void fire();
-    float range(float e);
-    float calculateElevation(float targetDistance);
-    vector<float> heightLine;
-    vector<float> velocityLine;
-    vector<float> energyLine;
+    // track of the cannon ball
+    int trailLength = 128;
+    YAMPE::SphereBatch trailSpheres;        ///< track drawn in one (instanced) draw call
+    YAMPE::SphereBatch ballSpheres;         ///< balls in flight drawn in one draw call
+    bool isLevelOfDetailEnabled = true;     ///< cull spheres out of view and coarsen small ones
 private:
 
     // or here